@@ -0,0 +1,197 @@
+#pragma once
+#ifndef AREALIGHT_H
+#define AREALIGHT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ltc.h"
+#include "shader.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Rectangular area light shaded analytically with linearly transformed cosines (Heitz et al. 2016):
+// one polygon integral per fragment for the diffuse term and one for the GGX specular term, instead
+// of a grid of point lights. The light is a rectangle facing down the -y axis.
+class AreaLightLTC
+{
+public:
+    // texture units the lookup tables are bound to, clear of the units the scene uses for its own textures
+    static const int TABLE_UNIT = 6;
+
+    glm::vec3 Center;
+    glm::vec2 HalfSize;     // along x and z
+    glm::vec3 Radiance;     // emitted radiance, the same in every direction
+
+    AreaLightLTC() : Center(0.0f), HalfSize(0.5f), Radiance(1.0f), tables{ 0, 0 }
+    {
+    }
+
+    ~AreaLightLTC()
+    {
+        glDeleteTextures(2, tables);
+    }
+
+    AreaLightLTC(const AreaLightLTC&) = delete;
+    AreaLightLTC& operator=(const AreaLightLTC&) = delete;
+
+    bool IsLoaded() const
+    {
+        return tables[0] != 0;
+    }
+
+    // loads the lookup tables into two textures, needs a current OpenGL context
+    bool Load(const char* path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        LtcTableHeader header = {};
+        if (!file.read((char*)&header, sizeof(header)) || !header.Valid())
+        {
+            std::cout << "ERROR::AREALIGHT::TABLE_NOT_FOUND: " << path << std::endl;
+            return false;
+        }
+        std::vector<float> data(header.TableBytes() / sizeof(float) * 2);
+        if (!file.read((char*)data.data(), header.TableBytes() * 2))
+        {
+            std::cout << "ERROR::AREALIGHT::TABLE_TRUNCATED: " << path << std::endl;
+            return false;
+        }
+
+        glDeleteTextures(2, tables);
+        glGenTextures(2, tables);
+        for (int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, tables[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, header.Size, header.Size);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, header.Size, header.Size, GL_RGBA, GL_FLOAT, &data[i * data.size() / 2]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        tableSize = header.Size;
+        return true;
+    }
+
+    // binds the tables and sets the light uniforms of a shader that is in use
+    void Apply(Shader& shader) const
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + TABLE_UNIT + i);
+            glBindTexture(GL_TEXTURE_2D, tables[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("ltc1", TABLE_UNIT);
+        shader.setInt("ltc2", TABLE_UNIT + 1);
+        shader.setFloat("ltcTableSize", (float)tableSize);
+
+        // wound counter-clockwise when seen from below, the side that emits
+        glm::vec3 corners[4] = {
+            Center + glm::vec3(-HalfSize.x, 0.0f, -HalfSize.y),
+            Center + glm::vec3(-HalfSize.x, 0.0f,  HalfSize.y),
+            Center + glm::vec3( HalfSize.x, 0.0f,  HalfSize.y),
+            Center + glm::vec3( HalfSize.x, 0.0f, -HalfSize.y),
+        };
+        for (int i = 0; i < 4; i++)
+            shader.setVec3("areaLightCorners[" + std::to_string(i) + "]", corners[i]);
+        shader.setVec3("areaLightRadiance", Radiance);
+    }
+
+private:
+    unsigned int tables[2];
+    unsigned int tableSize = 0;
+};
+
+// Measures the fragment cost of the area-lighting shader with the point light grid and with the LTC
+// rectangle: a full-screen quad is shaded into an offscreen target of the given size, timed with
+// GL_TIME_ELAPSED queries. Both paths shade the same pixels, so the ratio is the cost per fragment.
+inline void benchmarkAreaLight(Shader& shader, const AreaLightLTC& light, const std::vector<glm::vec3>& pointLights, int width, int height)
+{
+    unsigned int framebuffer, color, depth, vao, vbo;
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, width, height);
+
+    // a floor-sized quad right under the light, filling the view from above
+    float quad[] = {
+        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+         1.0f, -1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+        -1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // the quad lies in the plane below the light, the transforms map it onto the whole target
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, light.Center - glm::vec3(0.0f, 0.5f, 0.0f));
+    model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    shader.use();
+    shader.setMat4("model", model);
+    shader.setMat4("view", glm::mat4(1.0f));
+    shader.setMat4("projection", glm::inverse(model));
+    shader.setVec3("viewPos", light.Center);
+    shader.setVec3Array("lightPos", pointLights);
+    shader.setInt("lightNum", (int)pointLights.size());
+    shader.setVec3("lightColor", light.Radiance);
+    shader.setVec4("albedo", 0.6f, 0.6f, 0.6f, 1.0f);
+    shader.setFloat("metallic", 0.5f);
+    shader.setFloat("roughness", 0.3f);
+    shader.setFloat("specular", 1.0f);
+    light.Apply(shader);
+
+    const int DRAWS = 50;
+    unsigned int query;
+    glGenQueries(1, &query);
+    glDepthFunc(GL_ALWAYS);
+    std::cout << "area light benchmark, " << width << "x" << height << ", " << DRAWS << " full-screen draws" << std::endl;
+    double milliseconds[2];
+    for (int ltc = 0; ltc < 2; ltc++)
+    {
+        shader.setBool("useLTC", ltc == 1);
+        // once untimed so shader compilation and first-use costs stay out of the result
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glFinish();
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int i = 0; i < DRAWS; i++)
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        milliseconds[ltc] = nanoseconds / 1e6 / DRAWS;
+        std::cout << (ltc ? "LTC rectangle: " : std::to_string(pointLights.size()) + " point lights: ") << milliseconds[ltc] << " ms per frame, "
+                  << nanoseconds / double(DRAWS) / (double(width) * height) << " ns per fragment" << std::endl;
+    }
+    std::cout << "speedup: " << milliseconds[0] / milliseconds[1] << "x" << std::endl;
+
+    glDepthFunc(GL_LESS);
+    glDeleteQueries(1, &query);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depth);
+    glDeleteTextures(1, &color);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+#endif
@@ -0,0 +1,344 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Draw calls and the vertices or indices they submit, counted by wrapping glad's draw entry points
+// the same way installDrawChecks() does; the two can be installed together.
+namespace drawcount
+{
+    inline uint64_t Draws = 0, Vertices = 0;
+
+    inline PFNGLDRAWARRAYSPROC realDrawArrays = nullptr;
+    inline PFNGLDRAWARRAYSINSTANCEDPROC realDrawArraysInstanced = nullptr;
+    inline PFNGLDRAWELEMENTSPROC realDrawElements = nullptr;
+    inline PFNGLDRAWELEMENTSINSTANCEDPROC realDrawElementsInstanced = nullptr;
+    inline PFNGLDRAWRANGEELEMENTSPROC realDrawRangeElements = nullptr;
+    inline PFNGLDRAWELEMENTSBASEVERTEXPROC realDrawElementsBaseVertex = nullptr;
+
+    inline void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        Draws++;
+        Vertices += count;
+        realDrawArrays(mode, first, count);
+    }
+
+    inline void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        Draws++;
+        Vertices += (uint64_t)count * instancecount;
+        realDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    inline void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        Draws++;
+        Vertices += count;
+        realDrawElements(mode, count, type, indices);
+    }
+
+    inline void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+    {
+        Draws++;
+        Vertices += (uint64_t)count * instancecount;
+        realDrawElementsInstanced(mode, count, type, indices, instancecount);
+    }
+
+    inline void APIENTRY drawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices)
+    {
+        Draws++;
+        Vertices += count;
+        realDrawRangeElements(mode, start, end, count, type, indices);
+    }
+
+    inline void APIENTRY drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex)
+    {
+        Draws++;
+        Vertices += count;
+        realDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+    }
+}
+
+// hooks the counters into glad, call once after the OpenGL functions have been loaded
+inline void installDrawCounters()
+{
+    if (drawcount::realDrawElements)
+        return;
+    drawcount::realDrawArrays = glad_glDrawArrays;
+    drawcount::realDrawArraysInstanced = glad_glDrawArraysInstanced;
+    drawcount::realDrawElements = glad_glDrawElements;
+    drawcount::realDrawElementsInstanced = glad_glDrawElementsInstanced;
+    drawcount::realDrawRangeElements = glad_glDrawRangeElements;
+    drawcount::realDrawElementsBaseVertex = glad_glDrawElementsBaseVertex;
+
+    glad_glDrawArrays = drawcount::drawArrays;
+    glad_glDrawArraysInstanced = drawcount::drawArraysInstanced;
+    glad_glDrawElements = drawcount::drawElements;
+    glad_glDrawElementsInstanced = drawcount::drawElementsInstanced;
+    glad_glDrawRangeElements = drawcount::drawRangeElements;
+    glad_glDrawElementsBaseVertex = drawcount::drawElementsBaseVertex;
+}
+
+// A benchmark script: how many frames to render at which fixed timestep, a camera path as keyframes
+// that are interpolated linearly, and scene switches set at given times. One directive per line,
+// times in seconds of simulated time, '#' starts a comment:
+//
+//     frames 300
+//     timestep 0.0166667
+//     warmup 10                        frames rendered before any is measured
+//     camera 0.0  0.0 0.3 3.3  -90 0   time, position, yaw and pitch in degrees
+//     set 1.5 snow 1                   time, switch name, 0 or 1
+//     input stutter.rec                replays a recording of the window's input instead of a camera path
+class BenchmarkScript
+{
+public:
+    struct CameraKey
+    {
+        float Time;
+        glm::vec3 Position;
+        float Yaw, Pitch;
+    };
+
+    struct Setting
+    {
+        float Time;
+        std::string Name;
+        bool Value;
+    };
+
+    int Frames = 300, Warmup = 10;
+    float Timestep = 1.0f / 60.0f;
+    std::vector<CameraKey> Camera;
+    std::vector<Setting> Settings;
+    std::string Input;
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::SCRIPT_NOT_FOUND: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        for (int number = 1; std::getline(file, line); number++)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::string directive;
+            if (!(words >> directive))
+                continue;
+            bool ok;
+            if (directive == "frames")
+                ok = bool(words >> Frames);
+            else if (directive == "timestep")
+                ok = bool(words >> Timestep);
+            else if (directive == "warmup")
+                ok = bool(words >> Warmup);
+            else if (directive == "camera")
+            {
+                CameraKey key;
+                ok = bool(words >> key.Time >> key.Position.x >> key.Position.y >> key.Position.z >> key.Yaw >> key.Pitch);
+                Camera.push_back(key);
+            }
+            else if (directive == "input")
+                ok = bool(words >> Input);
+            else if (directive == "set")
+            {
+                Setting setting;
+                ok = bool(words >> setting.Time >> setting.Name >> setting.Value);
+                Settings.push_back(setting);
+            }
+            else
+                ok = false;
+            if (!ok)
+            {
+                std::cout << "ERROR::BENCHMARK::SCRIPT_SYNTAX: " << path << ":" << number << ": " << line << std::endl;
+                return false;
+            }
+        }
+        std::stable_sort(Camera.begin(), Camera.end(), [](const CameraKey& a, const CameraKey& b) { return a.Time < b.Time; });
+        std::stable_sort(Settings.begin(), Settings.end(), [](const Setting& a, const Setting& b) { return a.Time < b.Time; });
+        if (Camera.empty() && Input.empty())
+        {
+            std::cout << "ERROR::BENCHMARK::NO_CAMERA_PATH: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // camera pose at a time, held at the first and last keyframe outside the path
+    CameraKey CameraAt(float time) const
+    {
+        if (time <= Camera.front().Time)
+            return Camera.front();
+        for (size_t i = 1; i < Camera.size(); i++)
+        {
+            const CameraKey& a = Camera[i - 1];
+            const CameraKey& b = Camera[i];
+            if (time > b.Time)
+                continue;
+            float t = (time - a.Time) / std::max(b.Time - a.Time, 1e-6f);
+            return { time, glm::mix(a.Position, b.Position, t), glm::mix(a.Yaw, b.Yaw, t), glm::mix(a.Pitch, b.Pitch, t) };
+        }
+        return Camera.back();
+    }
+};
+
+// Runs the render loop through a script with a fixed timestep instead of the clock, and measures
+// every frame from its start until the GPU has finished it. The report is JSON: frame time
+// percentiles over the frames after the warm-up, draw calls per frame, the profiler's scopes and an
+// FNV-1a checksum of the last frame, which stays the same from run to run while the image does.
+class HeadlessBenchmark
+{
+public:
+    BenchmarkScript Script;
+
+    // switches maps the names scripts may set to the flags of the render loop
+    HeadlessBenchmark(const BenchmarkScript& script, const std::map<std::string, bool*>& switches) : Script(script), switches(switches), frame(0), nextSetting(0), frameStart(0)
+    {
+        for (const BenchmarkScript::Setting& setting : Script.Settings)
+            if (!switches.count(setting.Name))
+                std::cout << "WARNING::BENCHMARK::UNKNOWN_SWITCH: " << setting.Name << std::endl;
+    }
+
+    bool Running() const
+    {
+        return frame < Script.Frames;
+    }
+
+    // simulated time of the current frame
+    float Time() const
+    {
+        return frame * Script.Timestep;
+    }
+
+    // applies the settings due by the end of this frame and starts its clock
+    void BeginFrame()
+    {
+        for (; nextSetting < Script.Settings.size() && Script.Settings[nextSetting].Time < Time() + Script.Timestep; nextSetting++)
+        {
+            auto found = switches.find(Script.Settings[nextSetting].Name);
+            if (found != switches.end())
+                *found->second = Script.Settings[nextSetting].Value;
+        }
+        drawcount::Draws = 0;
+        drawcount::Vertices = 0;
+        frameStart = profiling::now();
+    }
+
+    // waits for the GPU to finish the frame and records it
+    void EndFrame()
+    {
+        glFinish();
+        if (frame >= Script.Warmup)
+        {
+            frameMilliseconds.push_back((profiling::now() - frameStart) / 1e6);
+            draws.push_back(drawcount::Draws);
+            vertices.push_back(drawcount::Vertices);
+        }
+        frame++;
+    }
+
+    // reads back the last frame from the default framebuffer and writes the report
+    bool WriteReport(const std::string& path, const std::string& scriptPath, int width, int height, const FrameProfiler& profiler) const
+    {
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        uint64_t checksum = 14695981039346656037ull;
+        for (unsigned char byte : pixels)
+            checksum = (checksum ^ byte) * 1099511628211ull;
+
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        std::vector<double> sorted(frameMilliseconds);
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double percent) {
+            return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(percent / 100.0 * sorted.size()))];
+        };
+        auto average = [](const auto& values) {
+            double sum = 0.0;
+            for (auto value : values)
+                sum += (double)value;
+            return values.empty() ? 0.0 : sum / values.size();
+        };
+
+        file << std::fixed << std::setprecision(3) << "{\n"
+             << "  \"script\": " << jsonString(scriptPath) << ",\n"
+             << "  \"width\": " << width << ",\n"
+             << "  \"height\": " << height << ",\n"
+             << "  \"frames\": " << frame << ",\n"
+             << "  \"measured_frames\": " << frameMilliseconds.size() << ",\n"
+             << "  \"timestep\": " << std::setprecision(6) << Script.Timestep << std::setprecision(3) << ",\n"
+             << "  \"frame_ms\": { \"average\": " << average(frameMilliseconds) << ", \"p50\": " << percentile(50.0) << ", \"p90\": " << percentile(90.0)
+             << ", \"p95\": " << percentile(95.0) << ", \"p99\": " << percentile(99.0) << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << " },\n"
+             << "  \"draws_per_frame\": { \"average\": " << average(draws) << ", \"max\": " << (draws.empty() ? 0 : *std::max_element(draws.begin(), draws.end())) << " },\n"
+             << "  \"vertices_per_frame\": { \"average\": " << average(vertices) << ", \"max\": " << (vertices.empty() ? 0 : *std::max_element(vertices.begin(), vertices.end())) << " },\n"
+             << "  \"scopes_ms\": [";
+        bool first = true;
+        for (const FrameProfiler::Scope& scope : profiler.Scopes)
+        {
+            // CPU-only scopes have no GPU time
+            file << (first ? "\n" : ",\n") << "    { \"name\": " << jsonString(scope.Name) << ", \"cpu\": " << scope.Cpu.Average() << ", \"gpu\": ";
+            if (scope.Gpu.Samples.empty())
+                file << "null }";
+            else
+                file << scope.Gpu.Average() << " }";
+            first = false;
+        }
+        file << "\n  ],\n"
+             << "  \"checksum\": \"" << std::hex << std::setw(16) << std::setfill('0') << checksum << "\"\n"
+             << "}\n";
+        std::cout << "benchmark: " << frameMilliseconds.size() << " frames measured, p50 " << percentile(50.0) << " ms, p99 " << percentile(99.0)
+                  << " ms, checksum " << std::hex << std::setw(16) << std::setfill('0') << checksum << std::dec << std::setfill(' ') << ", report in " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::map<std::string, bool*> switches;
+    int frame;
+    size_t nextSetting;
+    int64_t frameStart;
+    std::vector<double> frameMilliseconds;
+    std::vector<uint64_t> draws, vertices;
+
+    // a quoted JSON string; Windows paths are full of backslashes
+    static std::string jsonString(const std::string& text)
+    {
+        std::ostringstream out;
+        out << '"';
+        for (unsigned char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (c < 0x20)
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+            else
+                out << c;
+        }
+        out << '"';
+        return out.str();
+    }
+};
+#endif
@@ -0,0 +1,349 @@
+#pragma once
+#ifndef CLUSTERED_H
+#define CLUSTERED_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "parallel.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Point light with a finite range, its contribution is windowed to zero at Radius
+struct ClusterLight
+{
+    glm::vec3 Position;     // world space
+    float Radius;
+    glm::vec3 Color;        // intensity, the radiance at unit distance
+};
+
+// Clustered forward lighting: the view frustum is split into TILES_X x TILES_Y screen tiles and
+// SLICES depth slices, exponentially spaced between the near and far planes, and every frame each
+// light is assigned on the CPU to the clusters its sphere touches. Fragment shaders look up their
+// cluster and only loop over its lights, so the cost follows how many lights overlap a pixel rather
+// than how many lights there are.
+//
+// Three buffer textures hold the result: the lights, two RGBA32F texels each (position and radius,
+// colour), an RG32UI texel per cluster with the first entry and the count of its run in the index
+// list, and the R32UI index list itself, cluster-major.
+class ClusteredLights
+{
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    // texture units of the light, cluster and index buffers, after the area light tables
+    static const int TEXTURE_UNIT = 8;
+
+    std::vector<ClusterLight> Lights;   // filled by the caller before Build()
+
+    double BuildMilliseconds;           // time the last Build() took on the CPU
+    int IndexCount;                     // light references over all clusters
+    int OccupiedClusters;               // clusters with at least one light
+    int MaxClusterLights;               // lights in the most crowded cluster
+
+    // creates the buffer textures, needs a current OpenGL context
+    ClusteredLights() : BuildMilliseconds(0.0), IndexCount(0), OccupiedClusters(0), MaxClusterLights(0),
+        width(1), height(1), nearPlane(0.1f), farPlane(100.0f), grid(CLUSTER_COUNT * 2, 0), sliceLists(SLICES)
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        for (int i = 0; i < 3; i++)
+        {
+            // never empty, a buffer texture over no storage is incomplete
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ~ClusteredLights()
+    {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    // Assigns Lights to the clusters of a symmetric perspective projection and uploads the result.
+    // viewportWidth and viewportHeight are in pixels, nearZ and farZ are the clip planes of the projection.
+    void Build(const glm::mat4& view, const glm::mat4& projection, float nearZ, float farZ, int viewportWidth, int viewportHeight, unsigned int threads = 0)
+    {
+        auto start = std::chrono::steady_clock::now();
+        width = std::max(viewportWidth, 1);
+        height = std::max(viewportHeight, 1);
+        nearPlane = nearZ;
+        farPlane = farZ;
+        float sliceScale = SLICES / std::log(farZ / nearZ);
+
+        // view space positions, and every slice the sphere's depth range reaches
+        viewLights.resize(Lights.size());
+        for (auto& list : sliceLists)
+            list.clear();
+        for (int i = 0; i < (int)Lights.size(); i++)
+        {
+            glm::vec3 p = glm::vec3(view * glm::vec4(Lights[i].Position, 1.0f));
+            float r = Lights[i].Radius;
+            viewLights[i] = glm::vec4(p, r);
+            float depthMin = -p.z - r, depthMax = -p.z + r;
+            if (depthMax < nearZ || depthMin > farZ)
+                continue;
+            int first = depthMin <= nearZ ? 0 : std::min((int)(std::log(depthMin / nearZ) * sliceScale), SLICES - 1);
+            int last = std::min((int)(std::log(std::max(depthMax, nearZ) / nearZ) * sliceScale), SLICES - 1);
+            for (int slice = first; slice <= last; slice++)
+                sliceLists[slice].push_back(i);
+        }
+
+        // every slice owns a contiguous block of clusters, so slices fill their counts independently
+        std::fill(grid.begin(), grid.end(), 0u);
+        sliceTotals.assign(SLICES, 0);
+        sliceSpans.resize(SLICES);
+        float scaleX = projection[0][0], scaleY = projection[1][1];
+        parallelFor(SLICES, [&](int slice)
+        {
+            float sliceNear = nearZ * std::pow(farZ / nearZ, slice / float(SLICES));
+            float sliceFar = nearZ * std::pow(farZ / nearZ, (slice + 1) / float(SLICES));
+            auto& spans = sliceSpans[slice];
+            spans.clear();
+            unsigned int* counts = &grid[slice * TILES_X * TILES_Y * 2];
+            for (int light : sliceLists[slice])
+            {
+                TileSpan span = { light, glm::ivec4(0) };
+                if (!tileRect(viewLights[light], sliceNear, sliceFar, scaleX, scaleY, span.Tiles))
+                    continue;
+                spans.push_back(span);
+                for (int y = span.Tiles.y; y <= span.Tiles.w; y++)
+                    for (int x = span.Tiles.x; x <= span.Tiles.z; x++)
+                        counts[(y * TILES_X + x) * 2 + 1]++;
+                sliceTotals[slice] += (span.Tiles.z - span.Tiles.x + 1) * (span.Tiles.w - span.Tiles.y + 1);
+            }
+        }, threads);
+
+        std::vector<int> sliceBase(SLICES, 0);
+        IndexCount = 0;
+        for (int slice = 0; slice < SLICES; slice++)
+        {
+            sliceBase[slice] = IndexCount;
+            IndexCount += sliceTotals[slice];
+        }
+        indices.resize(std::max(IndexCount, 1));
+
+        parallelFor(SLICES, [&](int slice)
+        {
+            unsigned int* cells = &grid[slice * TILES_X * TILES_Y * 2];
+            unsigned int offset = sliceBase[slice];
+            for (int cell = 0; cell < TILES_X * TILES_Y; cell++)
+            {
+                cells[cell * 2] = offset;
+                offset += cells[cell * 2 + 1];
+                cells[cell * 2 + 1] = 0;    // counted again while filling
+            }
+            for (const TileSpan& span : sliceSpans[slice])
+                for (int y = span.Tiles.y; y <= span.Tiles.w; y++)
+                    for (int x = span.Tiles.x; x <= span.Tiles.z; x++)
+                    {
+                        unsigned int* cell = &cells[(y * TILES_X + x) * 2];
+                        indices[cell[0] + cell[1]++] = span.Light;
+                    }
+        }, threads);
+
+        OccupiedClusters = 0;
+        MaxClusterLights = 0;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            int count = (int)grid[cluster * 2 + 1];
+            OccupiedClusters += count > 0;
+            MaxClusterLights = std::max(MaxClusterLights, count);
+        }
+        BuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        upload();
+    }
+
+    // binds the buffers and sets the cluster uniforms of a shader that is in use
+    void Apply(Shader& shader, bool clustered = true) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("clusterLights", TEXTURE_UNIT);
+        shader.setInt("clusterGrid", TEXTURE_UNIT + 1);
+        shader.setInt("clusterIndices", TEXTURE_UNIT + 2);
+        shader.setBool("useClusters", clustered);
+        shader.setInt("clusterLightCount", (int)Lights.size());
+        shader.setVec2("clusterTileSize", glm::vec2(width / float(TILES_X), height / float(TILES_Y)));
+        shader.setVec2("clusterDepthRange", glm::vec2(nearPlane, farPlane));
+        shader.setFloat("clusterSliceScale", SLICES / std::log(farPlane / nearPlane));
+    }
+
+private:
+    // a light and the rectangle of tiles it covers in one slice, first x, first y, last x, last y
+    struct TileSpan
+    {
+        int Light;
+        glm::ivec4 Tiles;
+    };
+
+    unsigned int buffers[3], textures[3];
+    int width, height;
+    float nearPlane, farPlane;
+    std::vector<glm::vec4> viewLights;
+    std::vector<unsigned int> grid;             // (first, count) per cluster
+    std::vector<unsigned int> indices;
+    std::vector<std::vector<int>> sliceLists;   // lights whose depth range reaches each slice
+    std::vector<std::vector<TileSpan>> sliceSpans;     // tiles each light covers within each slice
+    std::vector<int> sliceTotals;
+    std::vector<glm::vec4> lightTexels;
+
+    // Screen tiles covered by a view space sphere (xyz, radius w) between two depths. The sphere's
+    // box is projected at whichever end of the depth range pushes each side outwards, which is
+    // conservative and cheap. Returns false when the light is off screen or misses the range.
+    static bool tileRect(const glm::vec4& light, float depthNear, float depthFar, float scaleX, float scaleY, glm::ivec4& rect)
+    {
+        float depthMin = std::max(-light.z - light.w, depthNear);
+        float depthMax = std::min(-light.z + light.w, depthFar);
+        if (depthMin > depthMax)
+            return false;
+        auto extent = [&](float low, float high, float scale, int tiles, int& first, int& last)
+        {
+            float ndcLow = scale * low / (low < 0.0f ? depthMin : depthMax);
+            float ndcHigh = scale * high / (high > 0.0f ? depthMin : depthMax);
+            if (ndcHigh < -1.0f || ndcLow > 1.0f)
+                return false;
+            first = std::clamp((int)std::floor((ndcLow * 0.5f + 0.5f) * tiles), 0, tiles - 1);
+            last = std::clamp((int)std::floor((ndcHigh * 0.5f + 0.5f) * tiles), 0, tiles - 1);
+            return true;
+        };
+        return extent(light.x - light.w, light.x + light.w, scaleX, TILES_X, rect.x, rect.z)
+            && extent(light.y - light.w, light.y + light.w, scaleY, TILES_Y, rect.y, rect.w);
+    }
+
+    void upload()
+    {
+        lightTexels.resize(std::max<size_t>(Lights.size() * 2, 1));
+        for (size_t i = 0; i < Lights.size(); i++)
+        {
+            lightTexels[i * 2] = glm::vec4(Lights[i].Position, Lights[i].Radius);
+            lightTexels[i * 2 + 1] = glm::vec4(Lights[i].Color, 0.0f);
+        }
+        // reallocated every frame so the driver can hand out fresh storage instead of waiting on the last frame
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[0]);
+        glBufferData(GL_TEXTURE_BUFFER, lightTexels.size() * sizeof(glm::vec4), lightTexels.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[1]);
+        glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), grid.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[2]);
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+// Measures how the two ways of shading point lights scale: a floor seen in perspective is lit by
+// more and more lights spread over it, once looping over every light and once over the lights of
+// each fragment's cluster. The draws are timed up to glFinish, so software rasterizers whose
+// timer queries only cover command submission are measured too. The shader needs the clustered
+// lighting uniforms of shaders/arealighting.fs.glsl.
+inline void benchmarkClusteredLights(Shader& shader, int width, int height)
+{
+    unsigned int framebuffer, color, depth, vao, vbo;
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, width, height);
+
+    // a 16 x 16 floor at y = 0
+    float quad[] = {
+        -8.0f, 0.0f, -8.0f,  0.0f, 1.0f, 0.0f,
+        -8.0f, 0.0f,  8.0f,  0.0f, 1.0f, 0.0f,
+         8.0f, 0.0f, -8.0f,  0.0f, 1.0f, 0.0f,
+         8.0f, 0.0f,  8.0f,  0.0f, 1.0f, 0.0f,
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glm::vec3 eye(0.0f, 3.0f, 9.0f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+    shader.use();
+    shader.setMat4("model", glm::mat4(1.0f));
+    shader.setMat4("view", view);
+    shader.setMat4("projection", projection);
+    shader.setVec3("viewPos", eye);
+    shader.setInt("lightNum", 0);
+    shader.setBool("useLTC", false);
+    shader.setVec4("albedo", 0.6f, 0.6f, 0.6f, 1.0f);
+    shader.setFloat("metallic", 0.5f);
+    shader.setFloat("roughness", 0.3f);
+    shader.setFloat("specular", 1.0f);
+
+    ClusteredLights clusters;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-8.0f, 8.0f), height01(0.05f, 0.5f), hue(0.2f, 1.0f);
+    const int DRAWS = 5;
+    glDepthFunc(GL_ALWAYS);
+    std::cout << "clustered lighting benchmark, " << width << "x" << height << ", " << DRAWS << " draws of a 16x16 floor, lights of radius 0.5" << std::endl;
+    for (int lightCount : { 16, 64, 256, 1024, 4096 })
+    {
+        clusters.Lights.clear();
+        for (int i = 0; i < lightCount; i++)
+            clusters.Lights.push_back({ glm::vec3(position(random), height01(random), position(random)), 0.5f, glm::vec3(hue(random), hue(random), hue(random)) * 0.05f });
+        clusters.Build(view, projection, 0.1f, 100.0f, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        double milliseconds[2];
+        for (int clustered = 0; clustered < 2; clustered++)
+        {
+            clusters.Apply(shader, clustered == 1);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glFinish();
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < DRAWS; i++)
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glFinish();
+            milliseconds[clustered] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / DRAWS;
+        }
+        std::cout << lightCount << " lights: every light " << milliseconds[0] << " ms, clustered " << milliseconds[1] << " ms + "
+                  << clusters.BuildMilliseconds << " ms to build, " << clusters.IndexCount / float(std::max(clusters.OccupiedClusters, 1))
+                  << " lights per occupied cluster, at most " << clusters.MaxClusterLights << std::endl;
+    }
+
+    glDepthFunc(GL_LESS);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depth);
+    glDeleteTextures(1, &color);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+#endif
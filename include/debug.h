@@ -0,0 +1,129 @@
+#pragma once
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+
+// Debug-build checks around OpenGL draw calls.
+// installDrawChecks() replaces glad's draw entry points with wrappers that verify every draw sources its
+// vertices and indices from GPU buffer objects; a draw still reading client-side arrays is reported on the console.
+namespace gldebug
+{
+    inline PFNGLDRAWARRAYSPROC realDrawArrays = nullptr;
+    inline PFNGLDRAWARRAYSINSTANCEDPROC realDrawArraysInstanced = nullptr;
+    inline PFNGLDRAWELEMENTSPROC realDrawElements = nullptr;
+    inline PFNGLDRAWELEMENTSINSTANCEDPROC realDrawElementsInstanced = nullptr;
+    inline PFNGLDRAWRANGEELEMENTSPROC realDrawRangeElements = nullptr;
+    inline PFNGLDRAWELEMENTSBASEVERTEXPROC realDrawElementsBaseVertex = nullptr;
+
+    // only the first few offenders are printed so a bad draw inside the render loop doesn't flood the console
+    const unsigned int MAX_REPORTS = 8;
+    inline unsigned int clientArrayDraws = 0;
+
+    inline void report(const char* call, const char* what)
+    {
+        if (clientArrayDraws++ < MAX_REPORTS)
+            std::cout << "WARNING::GL::CLIENT_SIDE_ARRAY: " << call << " reads " << what << " from client memory" << std::endl;
+    }
+
+    inline void checkVertexArrays(const char* call)
+    {
+        GLint attribCount = 0;
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attribCount);
+        for (GLint i = 0; i < attribCount; i++)
+        {
+            GLint enabled = 0, buffer = 0;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+            if (!enabled)
+                continue;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+            if (buffer == 0)
+                report(call, "vertex attributes");
+        }
+    }
+
+    inline GLsizeiptr indexSize(GLenum type)
+    {
+        return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+    // with an element buffer bound the "indices" argument is a byte offset into it; a client pointer
+    // passed there points far outside the buffer and the draw silently reads garbage or nothing
+    inline void checkElementArray(const char* call, GLsizei count, GLenum type, const void* indices)
+    {
+        GLint buffer = 0;
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+        if (buffer == 0)
+        {
+            report(call, "indices");
+        }
+        else
+        {
+            GLint64 size = 0;
+            glGetBufferParameteri64v(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+            if ((GLint64)(uintptr_t)indices + count * indexSize(type) > size)
+                report(call, "indices");
+        }
+        checkVertexArrays(call);
+    }
+
+    inline void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        checkVertexArrays("glDrawArrays");
+        realDrawArrays(mode, first, count);
+    }
+
+    inline void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        checkVertexArrays("glDrawArraysInstanced");
+        realDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    inline void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        checkElementArray("glDrawElements", count, type, indices);
+        realDrawElements(mode, count, type, indices);
+    }
+
+    inline void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+    {
+        checkElementArray("glDrawElementsInstanced", count, type, indices);
+        realDrawElementsInstanced(mode, count, type, indices, instancecount);
+    }
+
+    inline void APIENTRY drawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices)
+    {
+        checkElementArray("glDrawRangeElements", count, type, indices);
+        realDrawRangeElements(mode, start, end, count, type, indices);
+    }
+
+    inline void APIENTRY drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex)
+    {
+        checkElementArray("glDrawElementsBaseVertex", count, type, indices);
+        realDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+    }
+}
+
+// hooks the checks into glad, call once right after the OpenGL functions have been loaded
+inline void installDrawChecks()
+{
+    if (gldebug::realDrawElements)
+        return;
+    gldebug::realDrawArrays = glad_glDrawArrays;
+    gldebug::realDrawArraysInstanced = glad_glDrawArraysInstanced;
+    gldebug::realDrawElements = glad_glDrawElements;
+    gldebug::realDrawElementsInstanced = glad_glDrawElementsInstanced;
+    gldebug::realDrawRangeElements = glad_glDrawRangeElements;
+    gldebug::realDrawElementsBaseVertex = glad_glDrawElementsBaseVertex;
+
+    glad_glDrawArrays = gldebug::drawArrays;
+    glad_glDrawArraysInstanced = gldebug::drawArraysInstanced;
+    glad_glDrawElements = gldebug::drawElements;
+    glad_glDrawElementsInstanced = gldebug::drawElementsInstanced;
+    glad_glDrawRangeElements = gldebug::drawRangeElements;
+    glad_glDrawElementsBaseVertex = gldebug::drawElementsBaseVertex;
+}
+#endif
@@ -0,0 +1,234 @@
+#pragma once
+#ifndef DEPTHSORT_H
+#define DEPTHSORT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Back to front order of transparent primitives, for blending with GL_ONE_MINUS_SRC_ALPHA. The
+// view depth of every primitive's centre is quantized to 16 bits over the depth range of the set
+// and sorted with an LSD radix sort of two 8-bit digits; each pass histograms, offsets and
+// scatters contiguous chunks on their own thread, which keeps it stable. The order is written to
+// an element buffer that is drawn with the primitives' own vertex array. Sorting is skipped while
+// neither the view nor the primitives changed.
+class DepthSort
+{
+public:
+    static const int KEY_BITS = 16;
+    static const int DIGIT_BITS = 8;
+
+    std::vector<unsigned int> Order;    // primitive indices, farthest first
+    unsigned int Threads;               // threads a sort runs on, 0 = one per core
+
+    int Sorts, Skips;                   // sorts done, and sorts skipped because nothing moved
+    double SortMilliseconds;            // time of the last sort
+
+    DepthSort() : Threads(0), Sorts(0), Skips(0), SortMilliseconds(0.0), sortedCount(-1), modelView(0.0f), buffer(0), elementCount(0) {}
+
+    ~DepthSort()
+    {
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    DepthSort(const DepthSort&) = delete;
+    DepthSort& operator=(const DepthSort&) = delete;
+
+    // Orders count primitives whose centres, in the space modelViewMatrix maps to the view, are
+    // given by center(i). Pass changed when the centres moved since the last call. Returns false
+    // when the last order still holds and nothing was sorted.
+    template <typename Center>
+    bool Sort(const glm::mat4& modelViewMatrix, int count, Center center, bool changed)
+    {
+        if (!changed && count == sortedCount && modelViewMatrix == modelView)
+        {
+            Skips++;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        modelView = modelViewMatrix;
+        sortedCount = count;
+
+        int chunks = (int)std::min(Threads ? Threads : hardwareThreads(), (unsigned int)std::max(count / 4096, 1));
+        int chunkSize = (count + chunks - 1) / chunks;
+        depths.resize(count);
+        items.resize(count);
+        scratch.resize(count);
+        histograms.assign(chunks * RADIX, 0);
+
+        // view depth is minus the view space z, only the third row of the matrix is needed
+        glm::vec4 row(modelView[0][2], modelView[1][2], modelView[2][2], modelView[3][2]);
+        std::vector<float> chunkNear(chunks, 0.0f), chunkFar(chunks, 0.0f);
+        parallelFor(chunks, [&](int c) {
+            int first = c * chunkSize, last = std::min(first + chunkSize, count);
+            float nearest = 1e30f, farthest = -1e30f;
+            for (int i = first; i < last; i++)
+            {
+                float depth = -glm::dot(row, glm::vec4(center(i), 1.0f));
+                depths[i] = depth;
+                nearest = std::min(nearest, depth);
+                farthest = std::max(farthest, depth);
+            }
+            chunkNear[c] = nearest;
+            chunkFar[c] = farthest;
+        }, chunks);
+        float nearest = *std::min_element(chunkNear.begin(), chunkNear.end());
+        float farthest = *std::max_element(chunkFar.begin(), chunkFar.end());
+        float scale = ((1 << KEY_BITS) - 1) / std::max(farthest - nearest, 1e-6f);
+
+        // keys count up from the farthest primitive, with the index in the low half; the histogram
+        // of the first digit is taken on the way
+        parallelFor(chunks, [&](int c) {
+            int first = c * chunkSize, last = std::min(first + chunkSize, count);
+            unsigned int* histogram = &histograms[c * RADIX];
+            for (int i = first; i < last; i++)
+            {
+                uint64_t key = (uint64_t)((farthest - depths[i]) * scale);
+                items[i] = key << 32 | (uint32_t)i;
+                histogram[key & (RADIX - 1)]++;
+            }
+        }, chunks);
+
+        for (int shift = 32; shift < 32 + KEY_BITS; shift += DIGIT_BITS)
+        {
+            if (shift != 32)
+            {
+                histograms.assign(chunks * RADIX, 0);
+                parallelFor(chunks, [&](int c) {
+                    int first = c * chunkSize, last = std::min(first + chunkSize, count);
+                    unsigned int* histogram = &histograms[c * RADIX];
+                    for (int i = first; i < last; i++)
+                        histogram[(items[i] >> shift) & (RADIX - 1)]++;
+                }, chunks);
+            }
+
+            // each chunk writes a digit after the same digit of the chunks before it
+            unsigned int offset = 0;
+            for (int digit = 0; digit < RADIX; digit++)
+            {
+                for (int c = 0; c < chunks; c++)
+                {
+                    unsigned int size = histograms[c * RADIX + digit];
+                    histograms[c * RADIX + digit] = offset;
+                    offset += size;
+                }
+            }
+            parallelFor(chunks, [&](int c) {
+                int first = c * chunkSize, last = std::min(first + chunkSize, count);
+                unsigned int* offsets = &histograms[c * RADIX];
+                for (int i = first; i < last; i++)
+                    scratch[offsets[(items[i] >> shift) & (RADIX - 1)]++] = items[i];
+            }, chunks);
+            items.swap(scratch);
+        }
+
+        Order.resize(count);
+        parallelFor(chunks, [&](int c) {
+            int first = c * chunkSize, last = std::min(first + chunkSize, count);
+            for (int i = first; i < last; i++)
+                Order[i] = (uint32_t)items[i];
+        }, chunks);
+
+        Sorts++;
+        SortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // Writes the order to the element buffer, needs a current OpenGL context. With elements, each
+    // primitive i is elements[i * perPrimitive] to elements[i * perPrimitive + perPrimitive - 1],
+    // otherwise a primitive is the vertex of the same index.
+    void Upload(const std::vector<unsigned int>* elements = nullptr, int perPrimitive = 1)
+    {
+        const std::vector<unsigned int>* data = &Order;
+        if (elements)
+        {
+            expanded.resize(Order.size() * perPrimitive);
+            for (size_t i = 0; i < Order.size(); i++)
+                for (int k = 0; k < perPrimitive; k++)
+                    expanded[i * perPrimitive + k] = (*elements)[Order[i] * perPrimitive + k];
+            data = &expanded;
+        }
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, data->size() * sizeof(unsigned int), data->data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        elementCount = (int)data->size();
+    }
+
+    // draws the uploaded order with the attributes of a vertex array, and gives the vertex array
+    // its own element buffer back afterwards
+    void Draw(unsigned int vao, GLenum mode, unsigned int ownElementBuffer = 0) const
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        glDrawElements(mode, elementCount, GL_UNSIGNED_INT, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ownElementBuffer);
+        glBindVertexArray(0);
+    }
+
+private:
+    static const int RADIX = 1 << DIGIT_BITS;
+
+    int sortedCount;
+    glm::mat4 modelView;
+    std::vector<float> depths;
+    std::vector<uint64_t> items, scratch;
+    std::vector<unsigned int> histograms;   // per chunk and digit, turned into scatter offsets in place
+    std::vector<unsigned int> expanded;
+    unsigned int buffer;
+    int elementCount;
+};
+
+// Times the sort of random particles in a box seen in perspective, on one thread and on every
+// core, checks that the order runs back to front and that an unchanged view skips the sort.
+inline void benchmarkDepthSort()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.3f, 0.5f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const int RUNS = 5;
+    std::cout << "depth sort benchmark, " << DepthSort::KEY_BITS << "-bit keys, " << hardwareThreads() << " threads available" << std::endl;
+    for (int count : { 10000, 100000, 1000000 })
+    {
+        std::vector<glm::vec3> particles(count);
+        for (auto& particle : particles)
+            particle = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+        auto center = [&](int i) { return particles[i]; };
+
+        for (unsigned int threads : { 1u, hardwareThreads() })
+        {
+            DepthSort sort;
+            sort.Threads = threads;
+            // the first sort allocates the buffers
+            sort.Sort(view, count, center, true);
+            double milliseconds = 0.0;
+            for (int run = 0; run < RUNS; run++)
+            {
+                sort.Sort(view, count, center, true);
+                milliseconds += sort.SortMilliseconds / RUNS;
+            }
+            sort.Sort(view, count, center, false);
+
+            bool backToFront = true;
+            float quantum = 4.0f / (1 << DepthSort::KEY_BITS);
+            for (int i = 1; i < count && backToFront; i++)
+                backToFront = glm::dot(particles[sort.Order[i]] - particles[sort.Order[i - 1]], glm::vec3(glm::transpose(view)[2])) >= -quantum;
+            std::cout << count << " particles, " << threads << " threads: " << milliseconds << " ms, "
+                      << (backToFront ? "back to front" : "OUT OF ORDER") << ", " << sort.Skips << " skipped" << std::endl;
+            if (threads == hardwareThreads())
+                break;
+        }
+    }
+}
+#endif
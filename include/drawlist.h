@@ -0,0 +1,177 @@
+#pragma once
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "jobs.h"
+#include "parallel.h"
+#include "shader.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// view frustum as six planes pointing inwards, taken from a view-projection matrix
+class Frustum
+{
+public:
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];
+        planes[1] = m[3] - m[0];
+        planes[2] = m[3] + m[1];
+        planes[3] = m[3] - m[1];
+        planes[4] = m[3] + m[2];
+        planes[5] = m[3] - m[2];
+        for (glm::vec4& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    // false only when the sphere is entirely outside one of the planes
+    bool Intersects(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+
+// one draw of a command list: what to draw and the uniforms that differ from draw to draw
+struct DrawCommand
+{
+    unsigned int VAO = 0;
+    GLenum Mode = GL_TRIANGLES;
+    int First = 0;
+    int Count = 0;
+    glm::mat4 Model = glm::mat4(1.0f);
+    glm::vec3 Color = glm::vec3(1.0f);
+    bool Visible = true;                // false for draws the prepare phase culled
+};
+
+// Command list of one pass, the split between preparing a frame and submitting it. Prepare() builds
+// the commands on the job system, any number of them at once, since building one is only matrix math
+// with no OpenGL calls; Submit() then replays the list on the thread that owns the context. Uniforms
+// shared by the whole pass are set by the caller once, before Submit().
+class DrawList
+{
+public:
+    std::vector<DrawCommand> Commands;
+    double PrepareMilliseconds;         // time the last Prepare() took
+    int Submitted;                      // draws the last Submit() issued
+
+    DrawList() : PrepareMilliseconds(0.0), Submitted(0)
+    {
+    }
+
+    // Rebuilds the list with count commands, make(i, command) fills in the i-th one and may clear its
+    // Visible flag to cull it. Commands are made in chunks so each job has enough work to be worth it.
+    template <typename Make>
+    void Prepare(int count, Make make)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Commands.assign(count, DrawCommand());
+        int chunks = (count + CHUNK - 1) / CHUNK;
+        parallelFor(chunks, [&](int chunk)
+        {
+            for (int i = chunk * CHUNK; i < std::min(count, (chunk + 1) * CHUNK); i++)
+                make(i, Commands[i]);
+        });
+        PrepareMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // draws the visible commands with the shader's "model" uniform, and its colour uniform when a name
+    // is given; the vertex array is only bound again when it changes
+    void Submit(Shader& shader, const char* colorName = nullptr)
+    {
+        unsigned int boundVAO = 0;
+        Submitted = 0;
+        for (const DrawCommand& command : Commands)
+        {
+            if (!command.Visible)
+                continue;
+            shader.setMat4("model", command.Model);
+            if (colorName)
+                shader.setVec3(colorName, command.Color);
+            if (command.VAO != boundVAO)
+            {
+                glBindVertexArray(command.VAO);
+                boundVAO = command.VAO;
+            }
+            glDrawArrays(command.Mode, command.First, command.Count);
+            Submitted++;
+        }
+    }
+
+private:
+    static const int CHUNK = 64;
+};
+
+// CPU time of a frame's worth of objects at growing counts: preparing the list on one thread and on
+// the job system, with frustum culling, then the CPU side of submitting it. Needs a current OpenGL
+// context; the objects are unit cubes of vao scattered around the camera, most of them culled.
+inline void benchmarkDrawList(Shader& shader, unsigned int vao, int width, int height)
+{
+    using clock = std::chrono::steady_clock;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(projection * view);
+
+    shader.use();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+
+    std::cout << "draw list benchmark, " << JobSystem::Instance().Workers() + 1 << " threads" << std::endl;
+    std::cout << std::setw(8) << "objects" << std::setw(18) << "prepare 1 thread" << std::setw(18) << "prepare jobs"
+              << std::setw(14) << "submit" << std::setw(12) << "drawn" << std::endl;
+    for (int count : { 1000, 4000, 16000, 64000 })
+    {
+        DrawList list;
+        // each object spins about its own axis, so every frame really has to rebuild its matrix
+        auto make = [&](int i, DrawCommand& command)
+        {
+            float angle = i * 2.39996f;
+            float distance = 2.0f + (i % 97) * 0.4f;
+            glm::vec3 position(std::cos(angle) * distance, ((i * 7) % 13 - 6) * 0.5f, std::sin(angle) * distance);
+            command.Model = glm::rotate(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f)), angle, glm::vec3(0.3f, 1.0f, 0.2f));
+            command.VAO = vao;
+            command.Count = 36;
+            command.Color = glm::vec3((i % 3) / 2.0f, (i % 5) / 4.0f, (i % 7) / 6.0f);
+            command.Visible = frustum.Intersects(position, 0.2f);
+        };
+
+        // best of a few frames, the first one also pays for the allocation
+        double serial = 1e9, parallel = 1e9, submit = 1e9;
+        for (int frame = 0; frame < 5; frame++)
+        {
+            auto start = clock::now();
+            list.Commands.assign(count, DrawCommand());
+            for (int i = 0; i < count; i++)
+                make(i, list.Commands[i]);
+            serial = std::min(serial, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+            list.Prepare(count, make);
+            parallel = std::min(parallel, list.PrepareMilliseconds);
+
+            // only the CPU side of the submission, the GPU work is finished outside the timing
+            start = clock::now();
+            list.Submit(shader, "objectColor");
+            submit = std::min(submit, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            glFinish();
+        }
+        std::cout << std::setw(8) << count << std::fixed << std::setprecision(3) << std::setw(15) << serial << " ms"
+                  << std::setw(15) << parallel << " ms" << std::setw(11) << submit << " ms" << std::setw(12) << list.Submitted << std::endl;
+    }
+}
+#endif
@@ -0,0 +1,394 @@
+#pragma once
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+#include "shader.h"
+#include "terrain.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Erosion passes over a Heightmap. Both CPU passes split the grid into square tiles that are processed
+// in parallel, and both give bit-identical results for the same settings and iteration count no matter
+// how many threads run them.
+
+struct ThermalErosionSettings
+{
+    float Talus = 0.002f;   // height difference between neighbouring samples that stays stable
+    float Rate = 0.25f;     // fraction of the excess moved per iteration, at most 0.5 to stay stable
+};
+
+struct HydraulicErosionSettings
+{
+    unsigned int Seed = 1;
+    int CellsPerDroplet = 64;   // each iteration drops one droplet per this many samples
+    int Lifetime = 32;          // steps a droplet may run before it evaporates
+    int Radius = 2;             // radius of the brush droplets erode with
+    float Inertia = 0.05f;      // how much a droplet keeps its direction instead of following the slope
+    float Capacity = 4.0f;      // sediment a droplet can carry per unit of speed, water and slope
+    float MinCapacity = 0.0001f;
+    float Erosion = 0.3f;
+    float Deposition = 0.3f;
+    float Evaporation = 0.02f;
+    float Gravity = 4.0f;
+};
+
+// side length in samples of the tiles the grid is split into for the CPU passes
+const int EROSION_TILE = 64;
+
+// Thermal erosion: material slides from every sample to its lower 4-neighbours wherever the height
+// difference exceeds the talus, spread in proportion to the excess. Each iteration is written as a gather
+// from the previous heights, so a sample only reads a halo of two samples around itself; tiles read their
+// halo straight from the previous buffer, and swapping buffers between iterations is the halo exchange.
+inline void thermalErosion(Heightmap& heightmap, const ThermalErosionSettings& settings, int iterations, unsigned int threads = 0)
+{
+    const int size = heightmap.Size;
+    const int tiles = (size + EROSION_TILE - 1) / EROSION_TILE;
+    const int dx[4] = { 1, -1, 0, 0 };
+    const int dz[4] = { 0, 0, 1, -1 };
+    std::vector<float> buffer(heightmap.Heights.size());
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        const float* src = heightmap.Heights.data();
+        float* dst = buffer.data();
+
+        // material moving from (x, z) to each of its neighbours
+        auto outflow = [&](int x, int z, float flow[4])
+        {
+            float h = src[z * size + x];
+            float total = 0.0f, largest = 0.0f;
+            for (int i = 0; i < 4; i++)
+            {
+                int nx = x + dx[i], nz = z + dz[i];
+                flow[i] = 0.0f;
+                if (nx < 0 || nx >= size || nz < 0 || nz >= size)
+                    continue;
+                float difference = h - src[nz * size + nx];
+                if (difference > settings.Talus)
+                {
+                    flow[i] = difference - settings.Talus;
+                    total += flow[i];
+                    largest = std::max(largest, flow[i]);
+                }
+            }
+            for (int i = 0; i < 4 && total > 0.0f; i++)
+                flow[i] *= settings.Rate * largest / total;
+        };
+
+        parallelFor(tiles * tiles, [&](int tile)
+        {
+            int x0 = tile % tiles * EROSION_TILE, z0 = tile / tiles * EROSION_TILE;
+            int x1 = std::min(x0 + EROSION_TILE, size), z1 = std::min(z0 + EROSION_TILE, size);
+            for (int z = z0; z < z1; z++)
+            {
+                for (int x = x0; x < x1; x++)
+                {
+                    float h = src[z * size + x];
+                    float outgoing[4], incoming[4];
+                    outflow(x, z, outgoing);
+                    for (int i = 0; i < 4; i++)
+                    {
+                        int nx = x + dx[i], nz = z + dz[i];
+                        if (nx < 0 || nx >= size || nz < 0 || nz >= size)
+                            continue;
+                        // direction i and i ^ 1 are opposite
+                        outflow(nx, nz, incoming);
+                        h += incoming[i ^ 1] - outgoing[i];
+                    }
+                    dst[z * size + x] = h;
+                }
+            }
+        }, threads);
+
+        heightmap.Heights.swap(buffer);
+    }
+}
+
+// Particle based hydraulic erosion: droplets run downhill, picking up sediment where they speed up and
+// dropping it where they slow down. A droplet writes to the heights it passes, so tiles are run in four
+// checkerboard phases: tiles of one phase are a whole tile apart, and as long as their droplets stay within
+// half a tile of home they never touch the same samples. Inside a tile the droplets run one after another from
+// a generator seeded by (seed, iteration, tile), which makes the result independent of scheduling.
+inline void hydraulicErosion(Heightmap& heightmap, const HydraulicErosionSettings& settings, int iterations, unsigned int threads = 0)
+{
+    const int size = heightmap.Size;
+    const int tiles = (size + EROSION_TILE - 1) / EROSION_TILE;
+    const int halo = EROSION_TILE / 2 - settings.Radius - 2;
+    float* heights = heightmap.Heights.data();
+
+    // erosion brush, weights fall off linearly with distance and sum to one
+    std::vector<int> brushX, brushZ;
+    std::vector<float> brushWeight;
+    float weightSum = 0.0f;
+    for (int z = -settings.Radius; z <= settings.Radius; z++)
+    {
+        for (int x = -settings.Radius; x <= settings.Radius; x++)
+        {
+            float weight = settings.Radius + 1 - glm::sqrt(float(x * x + z * z));
+            if (weight <= 0.0f)
+                continue;
+            brushX.push_back(x);
+            brushZ.push_back(z);
+            brushWeight.push_back(weight);
+            weightSum += weight;
+        }
+    }
+    for (auto& weight : brushWeight)
+        weight /= weightSum;
+
+    // height and gradient at a position, bilinear over the four surrounding samples
+    auto sample = [&](float px, float pz, float& gradientX, float& gradientZ)
+    {
+        int x = int(px), z = int(pz);
+        float fx = px - x, fz = pz - z;
+        float h00 = heights[z * size + x], h10 = heights[z * size + x + 1];
+        float h01 = heights[(z + 1) * size + x], h11 = heights[(z + 1) * size + x + 1];
+        gradientX = (h10 - h00) * (1 - fz) + (h11 - h01) * fz;
+        gradientZ = (h01 - h00) * (1 - fx) + (h11 - h10) * fx;
+        return glm::mix(glm::mix(h00, h10, fx), glm::mix(h01, h11, fx), fz);
+    };
+
+    auto runTile = [&](int tile, int iteration)
+    {
+        int x0 = tile % tiles * EROSION_TILE, z0 = tile / tiles * EROSION_TILE;
+        int x1 = std::min(x0 + EROSION_TILE, size), z1 = std::min(z0 + EROSION_TILE, size);
+        // droplets stay far enough inside the tile plus its halo that the brush and the bilinear lookups do too
+        float minX = float(std::max(x0 - halo, 0) + settings.Radius);
+        float minZ = float(std::max(z0 - halo, 0) + settings.Radius);
+        float maxX = float(std::min(x1 + halo, size) - 1 - settings.Radius);
+        float maxZ = float(std::min(z1 + halo, size) - 1 - settings.Radius);
+
+        std::seed_seq seed{ settings.Seed, unsigned(iteration), unsigned(tile) };
+        std::mt19937 random(seed);
+        auto uniform = [&]() { return (random() >> 8) * (1.0f / 16777216.0f); };
+
+        int droplets = (x1 - x0) * (z1 - z0) / settings.CellsPerDroplet;
+        for (int droplet = 0; droplet < droplets; droplet++)
+        {
+            float px = glm::clamp(x0 + uniform() * (x1 - x0), minX, maxX - 0.001f);
+            float pz = glm::clamp(z0 + uniform() * (z1 - z0), minZ, maxZ - 0.001f);
+            float dirX = 0.0f, dirZ = 0.0f, speed = 1.0f, water = 1.0f, sediment = 0.0f;
+
+            for (int step = 0; step < settings.Lifetime; step++)
+            {
+                int cx = int(px), cz = int(pz);
+                float fx = px - cx, fz = pz - cz;
+                float gradientX, gradientZ;
+                float height = sample(px, pz, gradientX, gradientZ);
+
+                dirX = dirX * settings.Inertia - gradientX * (1 - settings.Inertia);
+                dirZ = dirZ * settings.Inertia - gradientZ * (1 - settings.Inertia);
+                float length = glm::sqrt(dirX * dirX + dirZ * dirZ);
+                if (length == 0.0f)
+                    break;
+                dirX /= length;
+                dirZ /= length;
+                px += dirX;
+                pz += dirZ;
+                if (px < minX || px >= maxX || pz < minZ || pz >= maxZ)
+                    break;
+
+                float newHeight = sample(px, pz, gradientX, gradientZ);
+                float deltaHeight = newHeight - height;
+                float capacity = std::max(-deltaHeight * speed * water * settings.Capacity, settings.MinCapacity);
+
+                if (sediment > capacity || deltaHeight > 0.0f)
+                {
+                    // uphill the droplet fills the pit behind it, otherwise it drops what it can't carry
+                    float deposit = deltaHeight > 0.0f ? std::min(deltaHeight, sediment) : (sediment - capacity) * settings.Deposition;
+                    sediment -= deposit;
+                    heights[cz * size + cx] += deposit * (1 - fx) * (1 - fz);
+                    heights[cz * size + cx + 1] += deposit * fx * (1 - fz);
+                    heights[(cz + 1) * size + cx] += deposit * (1 - fx) * fz;
+                    heights[(cz + 1) * size + cx + 1] += deposit * fx * fz;
+                }
+                else
+                {
+                    // never dig deeper than the height just lost, or the droplet would carve a pit
+                    float erode = std::min((capacity - sediment) * settings.Erosion, -deltaHeight);
+                    for (size_t i = 0; i < brushWeight.size(); i++)
+                    {
+                        float& h = heights[(cz + brushZ[i]) * size + cx + brushX[i]];
+                        float amount = std::min(h, erode * brushWeight[i]);
+                        h -= amount;
+                        sediment += amount;
+                    }
+                }
+
+                speed = glm::sqrt(std::max(speed * speed - deltaHeight * settings.Gravity, 0.0f));
+                water *= 1 - settings.Evaporation;
+            }
+        }
+    };
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        for (int phase = 0; phase < 4; phase++)
+        {
+            // tiles whose x and z parity match the phase
+            int phaseX = phase & 1, phaseZ = phase >> 1;
+            int countX = (tiles - phaseX + 1) / 2, countZ = (tiles - phaseZ + 1) / 2;
+            parallelFor(countX * countZ, [&](int i)
+            {
+                int tx = i % countX * 2 + phaseX, tz = i / countX * 2 + phaseZ;
+                runTile(tz * tiles + tx, iteration);
+            }, threads);
+        }
+    }
+}
+
+// Thermal erosion on the GPU: the same gather as thermalErosion(), one full-screen fragment pass per
+// iteration ping-ponging between two R32F textures. Works on the heightmap's texture in place.
+class GpuThermalErosion
+{
+public:
+    Shader Program;
+
+    // needs a current OpenGL context
+    GpuThermalErosion(unsigned int size)
+        : Program("shaders/erosion.vs.glsl", "shaders/erosion_thermal.fs.glsl"), size(size)
+    {
+        glGenTextures(2, textures);
+        glGenFramebuffers(2, framebuffers);
+        for (int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, size, size);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // the full-screen triangle is made from gl_VertexID, the vertex array only has to exist
+        glGenVertexArrays(1, &VAO);
+    }
+
+    ~GpuThermalErosion()
+    {
+        glDeleteTextures(2, textures);
+        glDeleteFramebuffers(2, framebuffers);
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    GpuThermalErosion(const GpuThermalErosion&) = delete;
+    GpuThermalErosion& operator=(const GpuThermalErosion&) = delete;
+
+    // erodes the uploaded heightmap texture, the CPU copy of the heights is left as it was
+    void Run(Heightmap& heightmap, const ThermalErosionSettings& settings, int iterations)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        glCopyImageSubData(heightmap.Texture, GL_TEXTURE_2D, 0, 0, 0, 0, textures[0], GL_TEXTURE_2D, 0, 0, 0, 0, size, size, 1);
+        glViewport(0, 0, size, size);
+        Program.use();
+        Program.setInt("heights", 0);
+        Program.setFloat("talus", settings.Talus);
+        Program.setFloat("rate", settings.Rate);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(VAO);
+        int current = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1 - current]);
+            glBindTexture(GL_TEXTURE_2D, textures[current]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            current = 1 - current;
+        }
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glCopyImageSubData(textures[current], GL_TEXTURE_2D, 0, 0, 0, 0, heightmap.Texture, GL_TEXTURE_2D, 0, 0, 0, 0, size, size, 1);
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int size;
+    unsigned int textures[2];
+    unsigned int framebuffers[2];
+    unsigned int VAO;
+};
+
+// FNV-1a over the raw bits of the heights, equal hashes mean bit-identical results
+inline uint64_t heightmapHash(const Heightmap& heightmap)
+{
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)heightmap.Heights.data();
+    for (size_t i = 0; i < heightmap.Heights.size() * sizeof(float); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Iterations per second of every erosion pass at 1024^2 and 4096^2, and a check that the CPU passes
+// give the same result on one thread and on all of them. The GPU pass needs a current OpenGL context.
+inline void benchmarkErosion()
+{
+    using clock = std::chrono::steady_clock;
+    ThermalErosionSettings thermal;
+    HydraulicErosionSettings hydraulic;
+    unsigned int threads = hardwareThreads();
+
+    // runs pass until it has taken at least a second, returns iterations per second
+    auto measure = [](auto pass)
+    {
+        int iterations = 0;
+        auto start = clock::now();
+        double seconds = 0.0;
+        while (seconds < 1.0 || iterations < 3)
+        {
+            pass();
+            iterations++;
+            seconds = std::chrono::duration<double>(clock::now() - start).count();
+        }
+        return iterations / seconds;
+    };
+
+    std::cout << "erosion benchmark, " << threads << " threads" << std::endl;
+    for (unsigned int size : { 1024u, 4096u })
+    {
+        Heightmap heightmap(size);
+        heightmap.GeneratePerlin(size / 10.0f, 3);
+
+        double thermalSingle = measure([&] { thermalErosion(heightmap, thermal, 1, 1); });
+        double thermalParallel = measure([&] { thermalErosion(heightmap, thermal, 1, threads); });
+        double hydraulicSingle = measure([&] { hydraulicErosion(heightmap, hydraulic, 1, 1); });
+        double hydraulicParallel = measure([&] { hydraulicErosion(heightmap, hydraulic, 1, threads); });
+
+        heightmap.Upload();
+        GpuThermalErosion gpu(size);
+        double thermalGpu = measure([&] { gpu.Run(heightmap, thermal, 10); glFinish(); }) * 10;
+
+        std::cout << size << "^2  thermal: " << thermalSingle << " it/s (1 thread), " << thermalParallel << " it/s (parallel), "
+                  << thermalGpu << " it/s (GPU)" << std::endl;
+        std::cout << size << "^2  hydraulic: " << hydraulicSingle << " it/s (1 thread), " << hydraulicParallel << " it/s (parallel), "
+                  << size * size / hydraulic.CellsPerDroplet << " droplets per iteration" << std::endl;
+    }
+
+    // the same seed and iteration count must give the same heights for any thread count,
+    // at least four threads so the check also means something on small machines
+    threads = std::max(threads, 4u);
+    Heightmap single(1024), parallel(1024);
+    single.GeneratePerlin(102.4f, 3);
+    parallel.Heights = single.Heights;
+    thermalErosion(single, thermal, 10, 1);
+    hydraulicErosion(single, hydraulic, 2, 1);
+    thermalErosion(parallel, thermal, 10, threads);
+    hydraulicErosion(parallel, hydraulic, 2, threads);
+    std::cout << "deterministic: " << (heightmapHash(single) == heightmapHash(parallel) ? "yes" : "NO") << std::endl;
+}
+#endif
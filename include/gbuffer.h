@@ -0,0 +1,174 @@
+#pragma once
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+#include <iostream>
+
+// Geometry buffer for deferred shading with shaders/arealighting.fs.glsl. Per pixel it holds the
+// octahedral normal (RG16), the albedo (RGBA8), metallic, roughness and specular with a coverage
+// flag in alpha (RGBA8) and the depth, in the window's depth format so it can be blitted back;
+// the position is rebuilt from the depth. The lighting pass draws one full-screen triangle with
+// the same shader, so every visible pixel evaluates the BRDF once however many surfaces were
+// drawn over it.
+class GBuffer
+{
+public:
+    // texture units the attachments are read from in the lighting pass, after the light clusters
+    static const int TEXTURE_UNIT = 11;
+
+    int Width, Height;
+
+    // creates the full-screen triangle, the attachments are made by Resize(), needs a current OpenGL context
+    GBuffer() : Width(0), Height(0), framebuffer(0), textures{ 0, 0, 0, 0 }
+    {
+        // a triangle covering clip space, with a normal for the attribute layout of the room meshes
+        float triangle[] = {
+            -1.0f, -1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+             3.0f, -1.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+            -1.0f,  3.0f, 0.0f,  0.0f, 0.0f, 1.0f,
+        };
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    ~GBuffer()
+    {
+        release();
+        glDeleteBuffers(1, &vbo);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+
+    // bytes per pixel over all attachments, depth counted as the 32 bits it is stored in
+    static int PixelBytes()
+    {
+        return 4 + 4 + 4 + 4;
+    }
+
+    // points the G-buffer samplers of a shader that is in use at their units; left at unit 0 they
+    // clash with samplers of other types there even in passes that never read the G-buffer
+    static void SetSamplers(Shader& shader)
+    {
+        shader.setInt("gNormal", TEXTURE_UNIT);
+        shader.setInt("gAlbedo", TEXTURE_UNIT + 1);
+        shader.setInt("gMaterial", TEXTURE_UNIT + 2);
+        shader.setInt("gDepth", TEXTURE_UNIT + 3);
+    }
+
+    // (re)creates the attachments when the size changed
+    void Resize(int width, int height)
+    {
+        if (width == Width && height == Height)
+            return;
+        release();
+        Width = width;
+        Height = height;
+
+        // depth blits need identical formats on both sides
+        GLint stencilBits = 0;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+        GLenum depthFormat = stencilBits > 0 ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+
+        const GLenum formats[4] = { GL_RG16, GL_RGBA8, GL_RGBA8, depthFormat };
+        glGenTextures(4, textures);
+        for (int i = 0; i < 4; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        for (int i = 0; i < 3; i++)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, stencilBits > 0 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[3], 0);
+        const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+        glDrawBuffers(3, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds and clears the G-buffer, the surfaces drawn next are stored instead of lit; blending is
+    // off, it would mix the packed values
+    void BeginGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_BLEND);
+    }
+
+    void EndGeometryPass()
+    {
+        glEnable(GL_BLEND);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Lights the stored surfaces into the window. The shader has to be in use with its lights set;
+    // this sets the G-buffer uniforms and clears them again afterwards. The stored depth is copied
+    // to the window too, so forward shaded objects drawn later are hidden behind the surfaces.
+    void LightingPass(Shader& shader, const glm::mat4& view, const glm::mat4& projection)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        SetSamplers(shader);
+        shader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        shader.setBool("readGBuffer", true);
+        shader.setMat4("model", glm::mat4(1.0f));
+        shader.setMat4("view", glm::mat4(1.0f));
+        shader.setMat4("projection", glm::mat4(1.0f));
+
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, Width, Height, 0, 0, Width, Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        shader.setBool("readGBuffer", false);
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+    }
+
+private:
+    unsigned int framebuffer, textures[4], vao, vbo;
+
+    void release()
+    {
+        if (framebuffer)
+            glDeleteFramebuffers(1, &framebuffer);
+        if (textures[0])
+            glDeleteTextures(4, textures);
+        framebuffer = 0;
+        textures[0] = textures[1] = textures[2] = textures[3] = 0;
+    }
+};
+#endif
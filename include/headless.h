@@ -0,0 +1,104 @@
+#pragma once
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <iostream>
+
+// OpenGL context without a window system, for the headless benchmark. EGL is asked for Mesa's
+// surfaceless platform when it has one, so no X or Wayland display is needed and llvmpipe renders
+// on a machine without a GPU; otherwise the default display is used. The scene draws into a pbuffer
+// the size of the window it replaces, which stands in for the window's default framebuffer.
+class HeadlessContext
+{
+public:
+    // makes a 4.5 core context current on the calling thread, check IsValid() afterwards
+    HeadlessContext(int width, int height) : display(EGL_NO_DISPLAY), surface(EGL_NO_SURFACE), context(EGL_NO_CONTEXT)
+    {
+        const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0)
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+            return;
+        }
+
+        const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "ERROR::HEADLESS::NO_EGL_CONTEXT: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            release();
+        }
+    }
+
+    ~HeadlessContext()
+    {
+        release();
+    }
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    bool IsValid() const
+    {
+        return context != EGL_NO_CONTEXT;
+    }
+
+    // OpenGL entry points for gladLoadGLLoader
+    static void* GetProcAddress(const char* name)
+    {
+        return (void*)eglGetProcAddress(name);
+    }
+
+private:
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+
+    void release()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+    }
+};
+#endif
+#endif
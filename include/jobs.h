@@ -0,0 +1,169 @@
+#pragma once
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// jobs started together, waited for together
+struct JobGroup
+{
+    std::atomic<int> Pending{ 0 };
+};
+
+// Work-stealing job system, one worker thread per core besides the thread that starts the jobs.
+// Every worker has a deque of its own: it runs its newest job first, which keeps the data its last
+// job touched in cache, and when the deque runs dry it steals the oldest job of another worker.
+// Jobs started from a thread that isn't a worker are dealt out round-robin. A thread waiting for a
+// group runs queued jobs itself until the group is done, so jobs may start and wait for jobs of
+// their own, and with no workers at all (a single core) the waiting thread simply runs everything.
+class JobSystem
+{
+public:
+    explicit JobSystem(unsigned int workers) : pending(0), next(0), stopping(false)
+    {
+        for (unsigned int i = 0; i < std::max(workers, 1u); i++)
+            queues.push_back(std::make_unique<Queue>());
+        for (unsigned int i = 0; i < workers; i++)
+            threads.emplace_back(&JobSystem::workerLoop, this, (int)i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // the system everything shares, started on first use
+    static JobSystem& Instance()
+    {
+        static JobSystem system(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return system;
+    }
+
+    unsigned int Workers() const
+    {
+        return (unsigned int)threads.size();
+    }
+
+    void Run(JobGroup& group, std::function<void()> job)
+    {
+        group.Pending.fetch_add(1, std::memory_order_relaxed);
+        int self = workerIndex();
+        Queue& queue = *queues[self >= 0 ? self : next.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+            queue.Jobs.push_back({ std::move(job), &group });
+        }
+        pending.fetch_add(1, std::memory_order_release);
+        // taking the lock orders this with a worker that is about to go to sleep, so the wake-up isn't lost
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // returns once every job of the group has run, running queued jobs in the meantime
+    void Wait(JobGroup& group)
+    {
+        int self = workerIndex();
+        while (group.Pending.load(std::memory_order_acquire) > 0)
+        {
+            if (!runOne(self))
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Job
+    {
+        std::function<void()> Function;
+        JobGroup* Group;
+    };
+
+    struct Queue
+    {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> pending;           // jobs queued and not taken yet
+    std::atomic<unsigned int> next;     // round-robin queue for jobs from other threads
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    // index of the calling worker, -1 on any other thread
+    static int& workerIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    // runs the newest job of the own queue or the oldest of another, false when there was none
+    bool runOne(int self)
+    {
+        Job job;
+        bool found = false;
+        if (self >= 0)
+            found = take(*queues[self], job, false);
+        for (size_t i = 1; !found && i <= queues.size(); i++)
+            found = take(*queues[(std::max(self, 0) + i) % queues.size()], job, true);
+        if (!found)
+            return false;
+        job.Function();
+        job.Group->Pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    bool take(Queue& queue, Job& job, bool oldest)
+    {
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Jobs.empty())
+            return false;
+        if (oldest)
+        {
+            job = std::move(queue.Jobs.front());
+            queue.Jobs.pop_front();
+        }
+        else
+        {
+            job = std::move(queue.Jobs.back());
+            queue.Jobs.pop_back();
+        }
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void workerLoop(int index)
+    {
+        workerIndex() = index;
+        while (true)
+        {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef LTC_H
+#define LTC_H
+
+#include <cstdint>
+#include <cstring>
+
+// Linearly transformed cosine lookup tables, written by tools/ltcfit and read by AreaLightLTC.
+// Both tables are Size x Size RGBA32F texels indexed by (roughness, sqrt(1 - cos theta_v)):
+//   table 1: the inverse LTC matrix, scaled so its middle entry is 1: m00, m02, m20, m22
+//   table 2: BRDF norm, Fresnel integral (the norm weighted by (1 - V.H)^5), unused, unused
+struct LtcTableHeader
+{
+    char Magic[4];          // "LTC1"
+    uint32_t Size;
+
+    bool Valid() const
+    {
+        return std::memcmp(Magic, "LTC1", 4) == 0 && Size >= 2 && Size <= 1024;
+    }
+
+    size_t TableBytes() const
+    {
+        return size_t(Size) * Size * 4 * sizeof(float);
+    }
+};
+#endif
@@ -104,7 +104,7 @@ public:
         shader.setVec4("Ks", mats.Ks);
         shader.setFloat("Ns", mats.Ns);
 
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indices.size(), indexType, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -114,6 +114,7 @@ public:
 private:
     // render data 
     unsigned int VBO, EBO;
+    GLenum indexType;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -132,8 +133,19 @@ private:
         //
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
+        // meshes small enough are uploaded with 16-bit indices, halving the index buffer
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        if (vertices.size() < 0xFFFF)
+        {
+            vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), &shortIndices[0], GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        }
 
         // set the vertex attribute pointers
         // vertex Positions
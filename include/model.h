@@ -18,10 +18,32 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <utility>
 #include <vector>
 using namespace std;
 
+// pixels of an image file as stb_image decodes them, before anything is uploaded
+struct TextureImage
+{
+    int width = 0, height = 0, nrComponents = 0;
+    unique_ptr<unsigned char, void (*)(void*)> data{ nullptr, stbi_image_free };
+};
+
+// one mesh of a model file in CPU memory: the vertex and index data, the material and the paths of
+// its textures (relative to the model's directory) together with the sampler name each one is for
+struct ImportedMesh
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    Material material;
+    vector<pair<string, string>> textures;
+};
+
+TextureImage DecodeTextureFile(const char* path, const string& directory);
+unsigned int TextureFromImage(const TextureImage& image, const char* path);
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+bool ImportModel(string const& path, vector<ImportedMesh>& meshes);
 
 class Model
 {
@@ -44,218 +66,238 @@ public:
     }
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // imports the model file, then creates the meshes and loads every texture the materials refer to.
     void loadModel(string const& path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        vector<ImportedMesh> imported;
+        if (!ImportModel(path, imported))
             return;
-        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
-
+        for (ImportedMesh& mesh : imported)
+        {
+            vector<Texture> textures;
+            for (const auto& texture : mesh.textures)
+                textures.push_back(loadTexture(texture.first, texture.second));
+            meshes.push_back(Mesh(mesh.vertices, mesh.indices, textures, mesh.material));
+        }
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // loads a material texture unless a texture with the same path has been loaded already
+    Texture loadTexture(const string& typeName, const string& path)
     {
-        // process each mesh located at the current node
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            //cout << "mesh name: " << mesh->mName.C_Str() << endl;
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
+        // check if texture was loaded before and if so, skip loading a new texture
+        for (unsigned int j = 0; j < textures_loaded.size(); j++)
         {
-            processNode(node->mChildren[i], scene);
+            if (textures_loaded[j].path == path)
+                return textures_loaded[j];
         }
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
     }
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+};
+
+// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+static void importNode(aiNode* node, const aiScene* scene, vector<ImportedMesh>& meshes);
+static ImportedMesh importMesh(aiMesh* mesh, const aiScene* scene);
+static void importMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, vector<pair<string, string>>& textures);
+
+// reads a model with supported ASSIMP extensions from file into meshes in CPU memory. Needs no OpenGL
+// context, so it can be timed or run on its own; Model uploads the result.
+bool ImportModel(string const& path, vector<ImportedMesh>& meshes)
+{
+    // read file via ASSIMP
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    // check for errors
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-        // walk through each of the mesh's vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-        {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
-            }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            vertices.push_back(vertex);
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-        {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
-        }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-        //读取mtl中的kd
-        Material mat;
-        aiColor3D color;
-        float Ns;
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-        mat.Ka = glm::vec4(color.r, color.g, color.b, 1.0);
-        material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-        mat.Kd = glm::vec4(color.r, color.g, color.b, 1.0);
-        material->Get(AI_MATKEY_COLOR_SPECULAR, color);
-        mat.Ks = glm::vec4(color.r, color.g, color.b, 1.0);
-        material->Get(AI_MATKEY_SHININESS, Ns);
-        mat.Ns = Ns;
+        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        return false;
+    }
+    // process ASSIMP's root node recursively
+    importNode(scene->mRootNode, scene, meshes);
+    return true;
+}
 
+static void importNode(aiNode* node, const aiScene* scene, vector<ImportedMesh>& meshes)
+{
+    // process each mesh located at the current node
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+        // the node object only contains indices to index the actual objects in the scene. 
+        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        meshes.push_back(importMesh(mesh, scene));
+    }
+    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        importNode(node->mChildren[i], scene, meshes);
+    }
+}
 
-        if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0 && material->GetTextureCount(aiTextureType_SPECULAR) == 0)
+static ImportedMesh importMesh(aiMesh* mesh, const aiScene* scene)
+{
+    // data to fill
+    ImportedMesh imported;
+    vector<Vertex>& vertices = imported.vertices;
+    vector<unsigned int>& indices = imported.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
+    // walk through each of the mesh's vertices
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        Vertex vertex;
+        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+        // positions
+        vector.x = mesh->mVertices[i].x;
+        vector.y = mesh->mVertices[i].y;
+        vector.z = mesh->mVertices[i].z;
+        vertex.Position = vector;
+        // normals
+        if (mesh->HasNormals())
         {
-            mat.useTex = false;
+            vector.x = mesh->mNormals[i].x;
+            vector.y = mesh->mNormals[i].y;
+            vector.z = mesh->mNormals[i].z;
+            vertex.Normal = vector;
         }
-        else
+        // texture coordinates
+        if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
         {
-            mat.useTex = true;
+            glm::vec2 vec;
+            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+            vec.x = mesh->mTextureCoords[0][i].x;
+            vec.y = mesh->mTextureCoords[0][i].y;
+            vertex.TexCoords = vec;
+            // tangent
+            vector.x = mesh->mTangents[i].x;
+            vector.y = mesh->mTangents[i].y;
+            vector.z = mesh->mTangents[i].z;
+            vertex.Tangent = vector;
+            // bitangent
+            vector.x = mesh->mBitangents[i].x;
+            vector.y = mesh->mBitangents[i].y;
+            vector.z = mesh->mBitangents[i].z;
+            vertex.Bitangent = vector;
         }
+        else
+            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+        vertices.push_back(vertex);
+    }
+    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        aiFace face = mesh->mFaces[i];
+        // retrieve all indices of the face and store them in the indices vector
+        for (unsigned int j = 0; j < face.mNumIndices; j++)
+            indices.push_back(face.mIndices[j]);
+    }
+    // process materials
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+    // Same applies to other texture as the following list summarizes:
+    // diffuse: texture_diffuseN
+    // specular: texture_specularN
+    // normal: texture_normalN
+    //读取mtl中的kd
+    Material& mat = imported.material;
+    aiColor3D color;
+    float Ns;
+    material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+    mat.Ka = glm::vec4(color.r, color.g, color.b, 1.0);
+    material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+    mat.Kd = glm::vec4(color.r, color.g, color.b, 1.0);
+    material->Get(AI_MATKEY_COLOR_SPECULAR, color);
+    mat.Ks = glm::vec4(color.r, color.g, color.b, 1.0);
+    material->Get(AI_MATKEY_SHININESS, Ns);
+    mat.Ns = Ns;
 
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> ambientMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ambient");
-        textures.insert(textures.end(), ambientMaps.begin(), ambientMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-        std::vector<Texture> opacityMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_opacity");
-        textures.insert(textures.end(), opacityMaps.begin(), opacityMaps.end());
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures, mat);
+    if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0 && material->GetTextureCount(aiTextureType_SPECULAR) == 0)
+    {
+        mat.useTex = false;
     }
+    else
+    {
+        mat.useTex = true;
+    }
+
+    // 1. diffuse maps
+    importMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", imported.textures);
+    // 2. specular maps
+    importMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", imported.textures);
+    // 3. normal maps
+    importMaterialTextures(material, aiTextureType_AMBIENT, "texture_ambient", imported.textures);
+    // 4. height maps
+    importMaterialTextures(material, aiTextureType_HEIGHT, "texture_height", imported.textures);
+
+    importMaterialTextures(material, aiTextureType_OPACITY, "texture_opacity", imported.textures);
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    return imported;
+}
+
+// appends the paths of all material textures of a given type, Model loads them once each.
+static void importMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, vector<pair<string, string>>& textures)
+{
+    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
-        vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
-        }
-        return textures;
+        aiString str;
+        mat->GetTexture(type, i, &str);
+        textures.push_back(make_pair(typeName, string(str.C_Str())));
     }
-};
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+}
+
+TextureImage DecodeTextureFile(const char* path, const string& directory)
 {
     string filename = path;
     filename = directory + '/' + filename;
+    TextureImage image;
+    //stbi_set_flip_vertically_on_load(true);
+    image.data.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0));//0
+    return image;
+}
+
+unsigned int TextureFromImage(const TextureImage& image, const char* path)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    int width, height, nrComponents;
-    //stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);//0
-    if (data)
+    if (image.data)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.nrComponents == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.nrComponents == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.nrComponents == 4)
             format = GL_RGBA;
 
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data.get());
         glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        stbi_image_free(data);
 
     }
     else
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
     return textureID;
 }
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+    return TextureFromImage(DecodeTextureFile(path, directory), path);
+}
 #endif
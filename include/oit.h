@@ -0,0 +1,148 @@
+#pragma once
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <iostream>
+
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013). Transparent surfaces
+// are drawn in any order into two targets: an RGBA16F sum of their premultiplied colours and
+// coverage, each weighted by a function of its depth, and an R8 revealage, the product of one minus
+// their coverages. One full-screen pass then puts the weighted average colour over the opaque image
+// with the coverage that is not revealed. Nothing is sorted and every transparent draw uses the
+// same blend state, whatever the number of primitives.
+//
+// The transparent shaders write the two targets when their weightedBlended uniform is set, see
+// writeWeightedBlended() in shaders/arealighting.fs.glsl.
+class WeightedBlendedOIT
+{
+public:
+    // texture units the targets are read from in the resolve pass, after the shadow maps
+    static const int TEXTURE_UNIT = 17;
+
+    int Width, Height;
+
+    // loads the resolve shader, the targets are made by Resize(), needs a current OpenGL context
+    WeightedBlendedOIT() : Width(0), Height(0), resolve("shaders/oit.vs.glsl", "shaders/oit.fs.glsl"), framebuffer(0), textures{ 0, 0, 0 }
+    {
+        // the full-screen triangle is made from gl_VertexID, core profiles still want a vertex array bound
+        glGenVertexArrays(1, &vao);
+        resolve.use();
+        resolve.setInt("accumulation", TEXTURE_UNIT);
+        resolve.setInt("revealage", TEXTURE_UNIT + 1);
+    }
+
+    ~WeightedBlendedOIT()
+    {
+        release();
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    WeightedBlendedOIT(const WeightedBlendedOIT&) = delete;
+    WeightedBlendedOIT& operator=(const WeightedBlendedOIT&) = delete;
+
+    // bytes per pixel of the two targets, without the copy of the depth
+    static int PixelBytes()
+    {
+        return 8 + 1;
+    }
+
+    // (re)creates the targets when the size changed
+    void Resize(int width, int height)
+    {
+        if (width == Width && height == Height)
+            return;
+        release();
+        Width = width;
+        Height = height;
+
+        // the window's depth is blitted in, which needs identical formats on both sides
+        GLint stencilBits = 0;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+        GLenum depthFormat = stencilBits > 0 ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+
+        const GLenum formats[3] = { GL_RGBA16F, GL_R8, depthFormat };
+        glGenTextures(3, textures);
+        for (int i = 0; i < 3; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[1], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, stencilBits > 0 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[2], 0);
+        const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::OIT::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Copies the depth of the opaque image, then binds and clears the targets. The transparent
+    // surfaces drawn next are tested against the opaque depth without writing it, and blend
+    // additively into the accumulation and multiplicatively into the revealage.
+    void BeginAccumulation()
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glBlitFramebuffer(0, 0, Width, Height, 0, 0, Width, Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, one);
+        glDepthMask(GL_FALSE);
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    }
+
+    void EndAccumulation()
+    {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_TRUE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // puts the accumulated transparency over the window's colour
+    void Resolve()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        resolve.use();
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    Shader resolve;
+    unsigned int framebuffer, textures[3], vao;
+
+    void release()
+    {
+        if (framebuffer)
+            glDeleteFramebuffers(1, &framebuffer);
+        if (textures[0])
+            glDeleteTextures(3, textures);
+        framebuffer = 0;
+        textures[0] = textures[1] = textures[2] = 0;
+    }
+};
+#endif
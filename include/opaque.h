@@ -0,0 +1,99 @@
+#pragma once
+#ifndef OPAQUE_H
+#define OPAQUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Opaque draws of one frame, queued in any order and drawn front to back by the view depth of
+// their centre, so nearer surfaces fill the depth buffer first and hide the fragments behind them.
+//
+// With the depth pre-pass on, the objects that have a depth draw lay down their depth first with
+// colour writes off; the colour pass then tests them with GL_EQUAL and without depth writes, so
+// each pixel runs the expensive fragment shader of one surface only. The depth draw must place the
+// vertices with the same expression as the colour draw (gl_Position declared invariant in both),
+// otherwise GL_EQUAL drops fragments. Objects whose fragment shader discards, or whose geometry is
+// too expensive to submit twice, are queued without a depth draw and are drawn normally, in order.
+class OpaqueQueue
+{
+public:
+    using DrawFunction = std::function<void()>;
+
+    bool PrePass;
+    int Draws, PrePassDraws;            // objects in the last colour pass, and how many of them had a depth draw
+
+    OpaqueQueue() : PrePass(false), Draws(0), PrePassDraws(0), view(1.0f) {}
+
+    // empties the queue, the objects queued next are sorted for this view
+    void Begin(const glm::mat4& viewMatrix, bool prePass)
+    {
+        items.clear();
+        view = viewMatrix;
+        PrePass = prePass;
+    }
+
+    // queues an object around a centre in world space; depth may be empty, see above
+    void Add(const glm::vec3& center, DrawFunction depth, DrawFunction color)
+    {
+        float viewDepth = -(view * glm::vec4(center, 1.0f)).z;
+        items.push_back({ viewDepth, std::move(depth), std::move(color) });
+    }
+
+    // sorts the queue front to back and, with the pre-pass on, draws the depth of the objects
+    void DepthPass()
+    {
+        std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.ViewDepth < b.ViewDepth; });
+        PrePassDraws = 0;
+        if (!PrePass)
+            return;
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (const Item& item : items)
+        {
+            if (!item.Depth)
+                continue;
+            item.Depth();
+            PrePassDraws++;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // draws the colour of the sorted objects and empties the queue; depth state is left at GL_LESS
+    // with writes on
+    void ColorPass()
+    {
+        for (const Item& item : items)
+        {
+            bool equal = PrePass && item.Depth;
+            glDepthFunc(equal ? GL_EQUAL : GL_LESS);
+            glDepthMask(equal ? GL_FALSE : GL_TRUE);
+            item.Color();
+        }
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        Draws = int(items.size());
+        items.clear();
+    }
+
+    // both passes
+    void Draw()
+    {
+        DepthPass();
+        ColorPass();
+    }
+
+private:
+    struct Item
+    {
+        float ViewDepth;
+        DrawFunction Depth, Color;
+    };
+
+    std::vector<Item> items;
+    glm::mat4 view;
+};
+#endif
@@ -0,0 +1,205 @@
+#pragma once
+#ifndef PACING_H
+#define PACING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+// windows.h as tiles.h includes it, unless it already has been
+#ifndef _WINDOWS_
+#undef APIENTRY
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include <timeapi.h>
+#endif
+
+// what the frame pacer measured over its last frames
+struct FramePacingStats
+{
+    int Frames = 0;
+    double PeriodMilliseconds = 0.0;    // interval the frames are paced to, 0 when nothing paces them
+    double MeanMilliseconds = 0.0;      // from the start of one frame to the start of the next
+    double JitterMilliseconds = 0.0;    // standard deviation of that interval
+    double WorstMilliseconds = 0.0;
+    int Missed = 0;                     // frames that took more than a quarter longer than the period
+    double Busy = 0.0;                  // share of the time spent on the frames themselves
+    double Sleeping = 0.0;              // share of the time the limiter slept
+    double Spinning = 0.0;              // share of the time the limiter spun on the clock
+    double SpinMarginMilliseconds = 0.0; // time before a deadline the limiter stops sleeping and spins
+};
+
+// Frame timing of the render loop: a monotonic clock in double precision, and a frame limiter that
+// holds the frames to a target rate without burning a core. The float seconds the loop used to keep
+// only resolve about 8 ms after a day of uptime, which is no use for the time between two frames.
+//
+// Wait() ends a frame. With a cap it sleeps until the next frame is due, in short slices while the
+// deadline is further away than a sleep may overshoot, then spins on the clock for the rest, so the
+// frames start on time even where the system sleeps in coarse steps; how far sleeps overshoot is
+// learned from the sleeps themselves. A frame that ends after its deadline starts the next one at
+// once instead of catching up. Without a cap Wait() returns at once and vsync, if on, paces the loop.
+class FramePacer
+{
+public:
+    double TargetRate;                  // frame cap in frames per second, 0 for none
+    double IdleRate;                    // lower cap while the application is idle, 0 for none
+    double DisplayRate;                 // rate vsync paces the frames to when there is no cap, 0 without vsync
+
+    explicit FramePacer(double targetRate = 0.0, double idleRate = 10.0)
+        : TargetRate(targetRate), IdleRate(idleRate), DisplayRate(0.0), start(std::chrono::steady_clock::now()),
+          frameStart(0.0), deadline(0.0), spinMargin(0.001), next(0)
+    {
+    }
+
+    // seconds since the pacer was made
+    double Now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Ends the frame that started at the last call, waiting until the next one is due; idle frames
+    // (a minimised window, say) are held to IdleRate. Returns when the next frame starts.
+    double Wait(bool idle = false)
+    {
+        double rate = TargetRate;
+        if (idle && IdleRate > 0.0)
+            rate = rate > 0.0 ? std::min(rate, IdleRate) : IdleRate;
+
+        Sample sample;
+        double now = Now();
+        sample.Busy = now - frameStart;
+        if (rate > 0.0)
+        {
+            sample.Period = 1.0 / rate;
+            deadline = std::max(deadline + sample.Period, frameStart);
+            if (now < deadline)
+                sleepUntil(deadline, sample);
+            else
+                deadline = now;
+        }
+        else
+        {
+            sample.Period = DisplayRate > 0.0 ? 1.0 / DisplayRate : 0.0;
+            deadline = now;
+        }
+
+        double started = Now();
+        sample.Interval = started - frameStart;
+        frameStart = started;
+        if (samples.size() < WINDOW)
+            samples.push_back(sample);
+        else
+            samples[next] = sample;
+        next = (next + 1) % WINDOW;
+        return started;
+    }
+
+    FramePacingStats Stats() const
+    {
+        FramePacingStats stats;
+        stats.Frames = (int)samples.size();
+        if (samples.empty())
+            return stats;
+        double total = 0.0, squares = 0.0, busy = 0.0, sleeping = 0.0, spinning = 0.0;
+        for (const Sample& sample : samples)
+        {
+            total += sample.Interval;
+            squares += sample.Interval * sample.Interval;
+            busy += sample.Busy;
+            sleeping += sample.Sleeping;
+            spinning += sample.Spinning;
+            stats.WorstMilliseconds = std::max(stats.WorstMilliseconds, sample.Interval * 1000.0);
+            if (sample.Period > 0.0 && sample.Interval > sample.Period * 1.25)
+                stats.Missed++;
+        }
+        double mean = total / samples.size();
+        stats.PeriodMilliseconds = samples[(next + samples.size() - 1) % samples.size()].Period * 1000.0;
+        stats.MeanMilliseconds = mean * 1000.0;
+        stats.JitterMilliseconds = std::sqrt(std::max(0.0, squares / samples.size() - mean * mean)) * 1000.0;
+        if (total > 0.0)
+        {
+            stats.Busy = busy / total;
+            stats.Sleeping = sleeping / total;
+            stats.Spinning = spinning / total;
+        }
+        stats.SpinMarginMilliseconds = spinMargin * 1000.0;
+        return stats;
+    }
+
+    void Print(std::ostream& out) const
+    {
+        FramePacingStats stats = Stats();
+        out << std::fixed << std::setprecision(2) << "frame pacing over " << stats.Frames << " frames: ";
+        if (stats.PeriodMilliseconds > 0.0)
+            out << "paced to " << stats.PeriodMilliseconds << " ms, ";
+        else
+            out << "unpaced, ";
+        out << "mean " << stats.MeanMilliseconds << " ms, jitter " << stats.JitterMilliseconds << " ms, worst "
+            << stats.WorstMilliseconds << " ms, " << stats.Missed << " missed deadlines; "
+            << std::setprecision(0) << stats.Busy * 100.0 << "% busy, " << stats.Sleeping * 100.0 << "% asleep, "
+            << stats.Spinning * 100.0 << "% spinning, spins the last " << std::setprecision(2)
+            << stats.SpinMarginMilliseconds << " ms" << std::endl;
+        out << std::defaultfloat;
+    }
+
+private:
+    static const size_t WINDOW = 240;
+    static constexpr double SLICE = 0.001;
+
+    struct Sample
+    {
+        double Interval = 0.0;
+        double Busy = 0.0;
+        double Sleeping = 0.0;
+        double Spinning = 0.0;
+        double Period = 0.0;
+    };
+
+    std::chrono::steady_clock::time_point start;
+    double frameStart;
+    double deadline;                    // when the next frame is due
+    double spinMargin;                  // how long before a deadline sleeping stops, see sleepUntil()
+    std::vector<Sample> samples;        // ring of the last WINDOW frames
+    size_t next;
+
+    // Sleeps mostly wake up a little late and now and then very late. The spin margin follows the
+    // 95th percentile of how late they wake up, stepping up a little after a sleep that overshot it
+    // and down a nineteenth of that after one that didn't, so a rare long sleep costs one missed
+    // deadline instead of turning every later wait into spinning. Windows sleeps in steps of the
+    // system timer, 15.6 ms unless someone asked for less, so the timer is set to 1 ms while it sleeps.
+    void sleepUntil(double until, Sample& sample)
+    {
+        double now = Now();
+#ifdef _WIN32
+        bool fineTimer = until - now > SLICE + spinMargin && timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+        while (until - now > SLICE + spinMargin)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(SLICE));
+            double woke = Now();
+            spinMargin += woke - now - SLICE > spinMargin ? 0.000095 : -0.000005;
+            spinMargin = std::clamp(spinMargin, 0.0001, 0.02);
+            sample.Sleeping += woke - now;
+            now = woke;
+        }
+#ifdef _WIN32
+        if (fineTimer)
+            timeEndPeriod(1);
+#endif
+        double spinStart = now;
+        while (now < until)
+        {
+            std::this_thread::yield();
+            now = Now();
+        }
+        sample.Spinning += now - spinStart;
+    }
+};
+#endif
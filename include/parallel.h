@@ -0,0 +1,47 @@
+#pragma once
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// number of worker threads used when a caller doesn't ask for a specific count
+inline unsigned int hardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls fn(i) for every i in [0, count) spread over the given number of threads (0 = one per core)
+// and returns once all calls are done. Indices are handed out one at a time in no fixed order,
+// so results must not depend on which thread runs which index. The threads are the job system's
+// workers, so calls are cheap enough for small counts and may be nested inside jobs.
+template <typename Function>
+void parallelFor(int count, Function fn, unsigned int threads = 0)
+{
+    if (threads == 0)
+        threads = hardwareThreads();
+    threads = std::min(threads, (unsigned int)std::max(count, 1));
+    if (threads <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto work = [&]()
+    {
+        for (int i = next++; i < count; i = next++)
+            fn(i);
+    };
+    JobSystem& jobs = JobSystem::Instance();
+    JobGroup group;
+    for (unsigned int t = 1; t < threads; t++)
+        jobs.Run(group, work);
+    work();
+    jobs.Wait(group);
+}
+#endif
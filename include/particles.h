@@ -0,0 +1,111 @@
+#pragma once
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+// CPU side of the snow and the light particles. Both live in the unit space of the room's inner
+// floor disk and are uploaded as they are, so the structs are also the vertex layouts. Nothing here
+// touches OpenGL; the caller copies the particles into their buffers after updating them.
+
+// snowflake
+struct SnowParticle
+{
+    glm::vec3 position;
+    glm::vec3 velocity;
+    glm::vec3 color;  // between white and light blue
+};
+
+// light particle, also a point light of the clustered lighting
+struct LightParticle
+{
+    glm::vec3 position;
+    glm::vec3 velocity;
+    glm::vec3 color;
+    float flashDelTime;
+};
+
+// cone around the Christmas tree, snow that falls into it starts over at the top
+struct SnowCollider
+{
+    float Top;
+    float Bottom;
+    float Radius;
+};
+
+// maps a point of the square [-1, 1]^2 onto the disk of the given radius
+inline glm::vec2 squareToDisk(float x, float z, float radius)
+{
+    return glm::vec2(x * glm::sqrt(1 - z * z / 2.0f), z * glm::sqrt(1 - x * x / 2.0f)) * radius;
+}
+
+// new snowflake somewhere above the floor, falling straight down
+inline void initSnowParticle(SnowParticle& particle)
+{
+    float x_r = (rand() % 100) / 100.0f * 2 - 1.0f;
+    float z_r = (rand() % 100) / 100.0f * 2 - 1.0f;
+    glm::vec2 disk = squareToDisk(x_r, z_r, 0.5f);
+
+    particle.position = glm::vec3(disk.x, (rand() % 100) / 100.0f * 1.5f, disk.y);
+    particle.velocity = glm::vec3(0.0f, (rand() % 100) / 100.0f * 0.2f - 0.3f, 0.0f);
+    float colorTmp = (rand() % 100) / 100.0f * 0.4f;
+    particle.color = glm::vec3(1.0f - colorTmp, 1.0f - colorTmp, 1.0f);
+}
+
+// new light particle drifting slowly in any direction
+inline void initLightParticle(LightParticle& particle)
+{
+    float x_r = (rand() % 100) / 100.0f * 2 - 1.0f;
+    float z_r = (rand() % 100) / 100.0f * 2 - 1.0f;
+    glm::vec2 disk = squareToDisk(x_r, z_r, 0.48f);
+
+    particle.position = glm::vec3(disk.x, (rand() % 100) / 100.0f * 1.15f + 0.05f, disk.y);
+    particle.velocity = glm::vec3((rand() % 100) / 100.0f * 0.06f - 0.03f, (rand() % 100) / 100.0f * 0.08f - 0.04f, (rand() % 100) / 100.0f * 0.06f - 0.03f);
+    float colorTmp = (rand() % 100) / 100.0f * 0.6f;
+    particle.color = glm::vec3(1.0f, 1.0f, 1.0f - colorTmp);
+
+    particle.flashDelTime = (rand() % 100) / 100.0f;
+}
+
+// moves the snow by one time step, flakes that reach the floor or the tree are respawned
+inline void updateSnowParticles(std::vector<SnowParticle>& particles, float deltaTime, const SnowCollider& tree)
+{
+    for (auto& particle : particles)
+    {
+        particle.position += particle.velocity * deltaTime;
+
+        float x = particle.position.x;
+        float y = particle.position.y;
+        float z = particle.position.z;
+
+        float radius = (tree.Top - y) / (tree.Top - tree.Bottom) * tree.Radius;
+        if (y < 0.0f || ((y <= tree.Top || y >= tree.Bottom) && x * x + z * z < radius * radius))
+            initSnowParticle(particle);
+    }
+}
+
+// moves the light particles by one time step, they bounce off the wall of the cylinder they live in
+inline void updateLightParticles(std::vector<LightParticle>& particles, float deltaTime)
+{
+    for (auto& particle : particles)
+    {
+        particle.position += particle.velocity * deltaTime;
+
+        float x = particle.position.x;
+        float y = particle.position.y;
+        float z = particle.position.z;
+
+        if (x * x + z * z > 0.48f * 0.48f)
+        {
+            particle.velocity.x *= -1;
+            particle.velocity.z *= -1;
+        }
+
+        if (y < 0.05f || y > 1.12f)
+            particle.velocity.y *= -1;
+    }
+}
+#endif
@@ -0,0 +1,641 @@
+#pragma once
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+// Swept pipe: a cross section morphed between three key sections (quadratic Bézier over each half of
+// the pipe) is moved along a cubic Bézier path. Rings of the sweep share their vertices with both
+// neighbouring segments, and normals are smoothed over the neighbouring rings and samples.
+//
+// Vertex data is one flat structure-of-arrays buffer: every position first, then every normal,
+// both ring-major. Each segment between two rings is drawn as one closed triangle strip.
+//
+// Edits through MoveControlPoint/MoveKeySection/SetSectionPoint only mark the rings and samples
+// that depend on what changed; Update() re-evaluates those and uploads just their byte ranges.
+class PipeSweep
+{
+public:
+    glm::vec3 ControlPoints[4];             // cubic Bézier path
+    std::vector<glm::vec3> KeySections[3];  // cross sections at the start, middle and end, same sample count each
+    std::vector<float> Rings;               // path parameter in [0, 1] of every ring
+    std::vector<int> Samples;               // key section samples used around every ring, in order
+
+    std::vector<float> Vertices;
+    std::vector<unsigned int> Indices;
+    double GenerateMilliseconds;            // time the last Generate() took
+    double UpdateMilliseconds;              // time the last Update() that changed anything took
+    int UpdatedRings;                       // rings re-evaluated by that Update()
+
+    unsigned int VAO, VBO, EBO;
+
+    PipeSweep() : GenerateMilliseconds(0.0), UpdateMilliseconds(0.0), UpdatedRings(0), VAO(0), VBO(0), EBO(0)
+    {
+        clearDirty();
+    }
+
+    ~PipeSweep()
+    {
+        if (VAO)
+        {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+    }
+
+    PipeSweep(const PipeSweep&) = delete;
+    PipeSweep& operator=(const PipeSweep&) = delete;
+
+    size_t VertexCount() const
+    {
+        return Rings.size() * Samples.size();
+    }
+
+    size_t TriangleCount() const
+    {
+        return Rings.size() > 1 ? (Rings.size() - 1) * Samples.size() * 2 : 0;
+    }
+
+    // byte offset of the first normal in the vertex buffer
+    size_t NormalOffset() const
+    {
+        return VertexCount() * 3 * sizeof(float);
+    }
+
+    // the strips of Indices as separate triangles with the strips' winding, three indices each, so
+    // the triangles can be drawn in an order of their own
+    std::vector<unsigned int> TriangleList() const
+    {
+        std::vector<unsigned int> triangles;
+        triangles.reserve(TriangleCount() * 3);
+        size_t stripStart = 0;
+        for (size_t i = 0; i < Indices.size(); i++)
+        {
+            if (Indices[i] == 0xFFFFFFFF)
+            {
+                stripStart = i + 1;
+                continue;
+            }
+            if (i < stripStart + 2)
+                continue;
+            bool odd = (i - stripStart) % 2 == 1;
+            triangles.push_back(Indices[odd ? i - 1 : i - 2]);
+            triangles.push_back(Indices[odd ? i - 2 : i - 1]);
+            triangles.push_back(Indices[i]);
+        }
+        return triangles;
+    }
+
+    // evenly spaced rings and every key section sample
+    void SetUniformSampling(int ringCount)
+    {
+        Rings.resize(ringCount);
+        for (int i = 0; i < ringCount; i++)
+            Rings[i] = i / float(ringCount);
+        Samples.resize(KeySections[0].size());
+        for (int j = 0; j < (int)Samples.size(); j++)
+            Samples[j] = j;
+    }
+
+    // Keeps a subset of a uniform grid of ringCount rings and every key section sample: a ring or
+    // sample is dropped when the surface it carried stays within tolerance of the chord between the
+    // kept neighbours and its normal within maxAngle degrees of theirs. Straight stretches and flat
+    // sides collapse, bends and corners keep their density. Distances are measured after scaling
+    // by scale, so passing the model scale gives a world-space tolerance.
+    void SetAdaptiveSampling(int ringCount, float tolerance, const glm::vec3& scale = glm::vec3(1.0f), float maxAngle = 10.0f)
+    {
+        SetUniformSampling(ringCount);
+        Generate();
+
+        int sampleCount = (int)Samples.size();
+        float minCos = glm::cos(glm::radians(maxAngle));
+        // around the section, every dense ring has to agree; samples close up into a loop
+        std::vector<int> samples = keepSpans(sampleCount, true, [&](int a, int b)
+        {
+            for (int i = 0; i < ringCount; i++)
+                for (int k = a + 1; k < b; k++)
+                    if (!spanFits(i, a % sampleCount, i, b % sampleCount, i, k, tolerance, scale, minCos))
+                        return false;
+            return true;
+        });
+        // along the path, measured on every dense sample so the dropped columns are covered too
+        std::vector<int> rings = keepSpans(ringCount, false, [&](int a, int b)
+        {
+            for (int j = 0; j < sampleCount; j++)
+                for (int k = a + 1; k < b; k++)
+                    if (!spanFits(a, j, b, j, k, j, tolerance, scale, minCos))
+                        return false;
+            return true;
+        });
+
+        std::vector<float> uniformRings = Rings;
+        Rings.clear();
+        for (int i : rings)
+            Rings.push_back(uniformRings[i]);
+        Samples = samples;
+    }
+
+    // cross section of the pipe at path parameter t, every key section sample, path offset included
+    std::vector<glm::vec3> EvaluateRing(float t) const
+    {
+        std::vector<glm::vec3> ring(KeySections[0].size());
+        RingBasis basis = ringBasis(t);
+        for (size_t j = 0; j < ring.size(); j++)
+            ring[j] = sectionPoint(basis, (int)j) + basis.Offset;
+        return ring;
+    }
+
+    // rebuilds every vertex and index, rings are evaluated in parallel
+    void Generate(unsigned int threads = 0)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        int ringCount = (int)Rings.size(), sampleCount = (int)Samples.size();
+        Vertices.resize(VertexCount() * 6);
+        basis.resize(ringCount);
+        for (int i = 0; i < ringCount; i++)
+            basis[i] = ringBasis(Rings[i]);
+
+        parallelFor(ringCount, [&](int i) { evaluatePositions(i, 0, sampleCount); }, threads);
+        parallelFor(ringCount, [&](int i) { evaluateNormals(i, 0, sampleCount); }, threads);
+
+        Indices.clear();
+        Indices.reserve((ringCount - 1) * (sampleCount * 2 + 3));
+        for (int i = 0; i + 1 < ringCount; i++)
+        {
+            unsigned int ring = i * sampleCount, next = ring + sampleCount;
+            for (int j = 0; j < sampleCount; j++)
+            {
+                Indices.push_back(ring + j);
+                Indices.push_back(next + j);
+            }
+            Indices.push_back(ring);
+            Indices.push_back(next);
+            Indices.push_back(0xFFFFFFFF);
+        }
+
+        clearDirty();
+        GenerateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The path is one cubic Bézier, so a control point reaches every ring where its Bernstein
+    // weight isn't zero, which leaves out at most the two ends of the pipe.
+    void MoveControlPoint(int index, const glm::vec3& position)
+    {
+        ControlPoints[index] = position;
+        markRings([index](float t) { return (index == 0 || t > 0.0f) && (index == 3 || t < 1.0f); }, 0, (int)Samples.size());
+    }
+
+    // translates a whole key section
+    void MoveKeySection(int section, const glm::vec3& offset)
+    {
+        for (glm::vec3& p : KeySections[section])
+            p += offset;
+        markSection(section, 0, (int)Samples.size());
+    }
+
+    void SetSectionPoint(int section, int sample, const glm::vec3& position)
+    {
+        KeySections[section][sample] = position;
+        // samples left out of the sweep don't reach any vertex
+        auto used = std::find(Samples.begin(), Samples.end(), sample);
+        if (used != Samples.end())
+        {
+            int j = int(used - Samples.begin());
+            markSection(section, j, j + 1);
+        }
+    }
+
+    // Re-evaluates the marked rings and uploads their positions and the normals around them.
+    // Returns false if nothing was marked since the last Generate() or Update().
+    bool Update(unsigned int threads = 0)
+    {
+        if (dirtyRingFirst >= dirtyRingLast)
+            return false;
+        auto start = std::chrono::steady_clock::now();
+
+        int ringCount = (int)Rings.size(), sampleCount = (int)Samples.size();
+        int first = dirtyRingFirst, last = dirtyRingLast;
+        for (int i = first; i < last; i++)
+            basis[i] = ringBasis(Rings[i]);
+        parallelFor(last - first, [&](int i) { evaluatePositions(first + i, dirtySampleFirst, dirtySampleLast); }, threads);
+
+        // normals are differences over the neighbouring rings and samples, so they change one further out
+        int normalFirst = std::max(first - 1, 0), normalLast = std::min(last + 1, ringCount);
+        int sampleFirst = dirtySampleFirst - 1, sampleLast = dirtySampleLast + 1;
+        if (sampleLast - sampleFirst >= sampleCount)
+        {
+            sampleFirst = 0;
+            sampleLast = sampleCount;
+        }
+        parallelFor(normalLast - normalFirst, [&](int i) { evaluateNormals(normalFirst + i, sampleFirst, sampleLast); }, threads);
+
+        // whole rings are contiguous in both halves of the buffer
+        size_t ringBytes = sampleCount * 3 * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * ringBytes, (last - first) * ringBytes, &Vertices[first * sampleCount * 3]);
+        glBufferSubData(GL_ARRAY_BUFFER, NormalOffset() + normalFirst * ringBytes, (normalLast - normalFirst) * ringBytes,
+                        &Vertices[VertexCount() * 3 + normalFirst * sampleCount * 3]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        UpdatedRings = last - first;
+        clearDirty();
+        UpdateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // creates the buffers and vertex array, needs a current OpenGL context
+    void Upload()
+    {
+        if (!VAO)
+        {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glGenBuffers(1, &EBO);
+        }
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(float), Vertices.data(), GL_DYNAMIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned int), Indices.data(), GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)NormalOffset());
+        glEnableVertexAttribArray(1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void Draw() const
+    {
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)Indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+private:
+    // Bézier weights of one ring, worked out once per ring instead of once per vertex
+    struct RingBasis
+    {
+        int Half;               // which pair of key sections the section morphs between
+        float Section[3];       // quadratic weights of the section morph
+        glm::vec3 Offset;       // point on the path
+    };
+
+    std::vector<RingBasis> basis;
+
+    // rings [dirtyRingFirst, dirtyRingLast) and samples [dirtySampleFirst, dirtySampleLast) wait for Update()
+    int dirtyRingFirst, dirtyRingLast, dirtySampleFirst, dirtySampleLast;
+
+    void clearDirty()
+    {
+        dirtyRingFirst = dirtySampleFirst = INT_MAX;
+        dirtyRingLast = dirtySampleLast = INT_MIN;
+    }
+
+    // marks every ring whose path parameter satisfies depends, together with the given samples
+    template <typename Predicate>
+    void markRings(Predicate depends, int sampleFirst, int sampleLast)
+    {
+        int first = INT_MAX, last = INT_MIN;
+        for (int i = 0; i < (int)Rings.size(); i++)
+        {
+            if (depends(Rings[i]))
+            {
+                first = std::min(first, i);
+                last = i + 1;
+            }
+        }
+        if (first >= last)
+            return;
+        dirtyRingFirst = std::min(dirtyRingFirst, first);
+        dirtyRingLast = std::max(dirtyRingLast, last);
+        dirtySampleFirst = std::min(dirtySampleFirst, sampleFirst);
+        dirtySampleLast = std::max(dirtySampleLast, sampleLast);
+    }
+
+    // Key section 0 only shapes the first half of the pipe and key section 2 only the second; the
+    // middle one is the end of the first morph and the start of the second, and lends its y and z
+    // to the middle control point of both.
+    void markSection(int section, int sampleFirst, int sampleLast)
+    {
+        if (section == 0)
+            markRings([](float t) { return t < 0.5f; }, sampleFirst, sampleLast);
+        else if (section == 2)
+            markRings([](float t) { return t > 0.5f; }, sampleFirst, sampleLast);
+        else
+            markRings([](float t) { return t > 0.0f; }, sampleFirst, sampleLast);
+    }
+
+    RingBasis ringBasis(float t) const
+    {
+        RingBasis b;
+        // the section morphs from key section 0 to 1 over the first half of the pipe, then from 1 to 2
+        b.Half = t < 0.5f ? 0 : 1;
+        float s = b.Half == 0 ? t * 2.0f : t * 2.0f - 1.0f;
+        b.Section[0] = (1 - s) * (1 - s);
+        b.Section[1] = 2 * s * (1 - s);
+        b.Section[2] = s * s;
+
+        float u = 1 - t;
+        b.Offset = u * u * u * ControlPoints[0] + 3 * t * u * u * ControlPoints[1] + 3 * t * t * u * ControlPoints[2] + t * t * t * ControlPoints[3];
+        return b;
+    }
+
+    glm::vec3 sectionPoint(const RingBasis& b, int sample) const
+    {
+        const glm::vec3& from = KeySections[b.Half][sample];
+        const glm::vec3& to = KeySections[b.Half + 1][sample];
+        // middle control point keeps the shape of the middle key section and halfway between along x
+        glm::vec3 middle((from.x + to.x) / 2.0f, KeySections[1][sample].y, KeySections[1][sample].z);
+        return b.Section[0] * from + b.Section[1] * middle + b.Section[2] * to;
+    }
+
+    glm::vec3 normal(int ring, int sample) const
+    {
+        const float* n = &Vertices[VertexCount() * 3 + (ring * Samples.size() + sample) * 3];
+        return glm::vec3(n[0], n[1], n[2]);
+    }
+
+    // whether vertex (ring, sample) may be dropped from the edge between vertices (ringA, sampleA) and (ringB, sampleB)
+    bool spanFits(int ringA, int sampleA, int ringB, int sampleB, int ring, int sample, float tolerance, const glm::vec3& scale, float minCos) const
+    {
+        glm::vec3 a = position(ringA, sampleA) * scale, b = position(ringB, sampleB) * scale, p = position(ring, sample) * scale;
+        glm::vec3 chord = b - a;
+        float lengthSquared = glm::dot(chord, chord);
+        float along = lengthSquared > 0.0f ? glm::clamp(glm::dot(p - a, chord) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+        if (glm::length(p - (a + along * chord)) > tolerance)
+            return false;
+        glm::vec3 n = normal(ring, sample);
+        return glm::dot(n, normal(ringA, sampleA)) >= minCos && glm::dot(n, normal(ringB, sampleB)) >= minCos;
+    }
+
+    // Greedily stretches every span from the last kept index as far as fits(first, last) allows and
+    // returns the kept indices. A closed sequence wraps around, index count standing for index 0.
+    template <typename Fits>
+    static std::vector<int> keepSpans(int count, bool closed, Fits fits)
+    {
+        std::vector<int> kept = { 0 };
+        int end = closed ? count : count - 1;
+        for (int a = 0; a < end;)
+        {
+            int b = a + 1;
+            while (b < end && fits(a, b + 1))
+                b++;
+            if (b < count)
+                kept.push_back(b);
+            a = b;
+        }
+        return kept;
+    }
+
+    glm::vec3 position(int ring, int sample) const
+    {
+        const float* p = &Vertices[(ring * Samples.size() + sample) * 3];
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    void evaluatePositions(int ring, int sampleFirst, int sampleLast)
+    {
+        const RingBasis& b = basis[ring];
+        float* out = &Vertices[(ring * Samples.size() + sampleFirst) * 3];
+        for (int j = sampleFirst; j < sampleLast; j++)
+        {
+            glm::vec3 p = sectionPoint(b, Samples[j]) + b.Offset;
+            *out++ = p.x;
+            *out++ = p.y;
+            *out++ = p.z;
+        }
+    }
+
+    // central differences along the path and around the ring, one-sided at the ends of the pipe;
+    // crossing them averages the face normals of the four quads around the vertex.
+    // The sample range may run one past either end, it wraps around the ring.
+    void evaluateNormals(int ring, int sampleFirst, int sampleLast)
+    {
+        int ringCount = (int)Rings.size(), sampleCount = (int)Samples.size();
+        int previous = std::max(ring - 1, 0), next = std::min(ring + 1, ringCount - 1);
+        for (int k = sampleFirst; k < sampleLast; k++)
+        {
+            int j = (k + sampleCount) % sampleCount;
+            float* out = &Vertices[VertexCount() * 3 + (ring * sampleCount + j) * 3];
+            glm::vec3 along = position(next, j) - position(previous, j);
+            glm::vec3 around = position(ring, (j + 1) % sampleCount) - position(ring, (j + sampleCount - 1) % sampleCount);
+            glm::vec3 normal = glm::cross(along, around);
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            *out++ = normal.x;
+            *out++ = normal.y;
+            *out++ = normal.z;
+        }
+    }
+};
+
+// The same sweep evaluated on the GPU: only the control points and key sections are uploaded, into
+// a buffer texture, and the tessellation shaders generate the surface every frame with a level of
+// detail that follows the distance to the eye. The pipe is drawn as a grid of attribute-less quad
+// patches, PATCHES_ALONG along the path by PATCHES_AROUND around the section.
+//
+// Buffer layout, one RGB32F texel each: the 4 control points, then every sample of key sections 0, 1 and 2.
+class GpuPipeSweep
+{
+public:
+    static const int PATCHES_ALONG = 32;
+    static const int PATCHES_AROUND = 8;
+    static const int MAX_TESS_LEVEL = 64;  // the same as in pipe.tesc.glsl
+
+    Shader Program;
+    int SampleCount;
+    float PathEnd;      // path parameter of the last ring, the CPU sweep stops short of 1 too
+
+    // compiles the shaders and creates the buffer texture, needs a current OpenGL context
+    GpuPipeSweep() : Program("shaders/pipe.vs.glsl", "shaders/arealighting.fs.glsl", "shaders/pipe.tesc.glsl", "shaders/pipe.tese.glsl", nullptr),
+        SampleCount(0), PathEnd(1.0f)
+    {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        glGenVertexArrays(1, &vao);
+    }
+
+    ~GpuPipeSweep()
+    {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    GpuPipeSweep(const GpuPipeSweep&) = delete;
+    GpuPipeSweep& operator=(const GpuPipeSweep&) = delete;
+
+    // bytes the GPU holds for the pipe
+    size_t Bytes() const
+    {
+        return (4 + 3 * SampleCount) * sizeof(glm::vec3);
+    }
+
+    // copies the control points and key sections of a CPU sweep, a few kilobytes at most
+    void Upload(const PipeSweep& pipe)
+    {
+        std::vector<glm::vec3> data(pipe.ControlPoints, pipe.ControlPoints + 4);
+        for (int i = 0; i < 3; i++)
+            data.insert(data.end(), pipe.KeySections[i].begin(), pipe.KeySections[i].end());
+        SampleCount = (int)pipe.KeySections[0].size();
+        PathEnd = pipe.Rings.empty() ? 1.0f : pipe.Rings.back();
+
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(glm::vec3), data.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Program has to be in use with its model, view, projection, viewPos and detail uniforms set
+    void Draw()
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        Program.setInt("pipeData", 0);
+        Program.setInt("sampleCount", SampleCount);
+        Program.setFloat("pathEnd", PathEnd);
+        Program.setInt("patchesAlong", PATCHES_ALONG);
+        Program.setInt("patchesAround", PATCHES_AROUND);
+        // the normals' step along the path is the spacing of the finest tessellation, whatever the layout of the buffer
+        Program.setFloat("normalStep", PathEnd / (PATCHES_ALONG * MAX_TESS_LEVEL));
+
+        // one vertex per patch, put back the default of 3 that the terrain relies on afterwards
+        glPatchParameteri(GL_PATCH_VERTICES, 1);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_PATCHES, 0, PATCHES_ALONG * PATCHES_AROUND);
+        glBindVertexArray(0);
+        glPatchParameteri(GL_PATCH_VERTICES, 3);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+private:
+    unsigned int buffer, texture, vao;
+};
+
+// Pipe whose cross section is blended from any number of key sections, each animated over a loop of
+// keyframes. The vertex shader does the blending with uniform Catmull-Rom splines, along the path
+// between the evenly spaced key sections and over time between keyframes, so animating it costs
+// one uniform per frame. The mesh has no vertex data: gl_VertexID is the position in the ring-major
+// grid, and only the strip indices live in a buffer.
+//
+// Buffer texture layout, one RGB32F texel each: the 4 path control points, then the key section
+// samples, frame-major, then key, then sample.
+class MorphingPipe
+{
+public:
+    Shader Program;
+    int RingCount, SampleCount;
+    int KeyCount, FrameCount;
+    float FrameSeconds;     // time from one keyframe to the next
+
+    // compiles the shader and builds the index grid, needs a current OpenGL context
+    MorphingPipe(int ringCount, int sampleCount) : Program("shaders/pipe_morph.vs.glsl", "shaders/arealighting.fs.glsl"),
+        RingCount(ringCount), SampleCount(sampleCount), KeyCount(0), FrameCount(0), FrameSeconds(1.0f)
+    {
+        std::vector<unsigned int> indices;
+        indices.reserve((ringCount - 1) * (sampleCount * 2 + 3));
+        for (int i = 0; i + 1 < ringCount; i++)
+        {
+            unsigned int ring = i * sampleCount, next = ring + sampleCount;
+            for (int j = 0; j < sampleCount; j++)
+            {
+                indices.push_back(ring + j);
+                indices.push_back(next + j);
+            }
+            indices.push_back(ring);
+            indices.push_back(next);
+            indices.push_back(0xFFFFFFFF);
+        }
+        indexCount = (int)indices.size();
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+    }
+
+    ~MorphingPipe()
+    {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+        glDeleteBuffers(1, &ebo);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    MorphingPipe(const MorphingPipe&) = delete;
+    MorphingPipe& operator=(const MorphingPipe&) = delete;
+
+    // sections holds frameCount * keyCount key sections of SampleCount samples each, frame-major;
+    // at least 2 key sections and 1 keyframe
+    void SetSections(int keyCount, int frameCount, const glm::vec3 controlPoints[4], const std::vector<glm::vec3>& sections)
+    {
+        KeyCount = keyCount;
+        FrameCount = frameCount;
+        std::vector<glm::vec3> data(controlPoints, controlPoints + 4);
+        data.insert(data.end(), sections.begin(), sections.end());
+
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(glm::vec3), data.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // replaces just the path, 48 bytes
+    void SetControlPoints(const glm::vec3 controlPoints[4])
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, 4 * sizeof(glm::vec3), controlPoints);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Program has to be in use with its model, view and projection uniforms set
+    void Draw(float seconds)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        Program.setInt("pipeData", 0);
+        Program.setInt("keyCount", KeyCount);
+        Program.setInt("frameCount", FrameCount);
+        Program.setInt("sampleCount", SampleCount);
+        Program.setInt("ringCount", RingCount);
+        Program.setFloat("frame", std::fmod(seconds / FrameSeconds, (float)FrameCount));
+
+        glBindVertexArray(vao);
+        glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+private:
+    unsigned int vao, ebo, buffer, texture;
+    int indexCount;
+};
+#endif
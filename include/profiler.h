@@ -0,0 +1,497 @@
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Frame profiler. CpuScope times the enclosing block on whatever thread runs it; the finished scope
+// goes into a ring owned by that thread, which only that thread writes and only the profiler reads,
+// so recording takes no lock. ProfileScope times a block of the render loop on the CPU and also on
+// the GPU, with a GL_TIMESTAMP written before and after its commands; timestamps nest, unlike
+// GL_TIME_ELAPSED queries, and are read back a few frames later like AsyncQuery, so nothing stalls.
+//
+// Once a frame the profiler drains the rings and picks up the timestamps that arrived, adds up the
+// time of every scope name in that frame, and keeps the last frames of each for rolling averages
+// and percentiles. The events of the last few seconds can be written as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) with the GPU on its own track.
+namespace profiling
+{
+    // a finished scope, times in nanoseconds of the steady clock since the program started
+    struct Event
+    {
+        const char* Name;       // string literal, scopes are matched by its contents
+        int64_t Start, End;
+        int Thread;             // ring the scope was recorded into, GPU_THREAD for timestamps
+        int Depth;              // scopes open around it on the same thread
+    };
+
+    const int MAX_THREADS = 32;
+    const int GPU_THREAD = MAX_THREADS;
+
+    inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    inline int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Single producer, single consumer ring of finished scopes. A full ring drops the scope rather
+    // than wait for the profiler.
+    class EventRing
+    {
+    public:
+        static const uint32_t CAPACITY = 1024;
+
+        std::atomic<bool> Claimed{ false };
+
+        // owning thread only
+        bool Push(const Event& event)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == CAPACITY)
+                return false;
+            events[h % CAPACITY] = event;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // profiler only, calls fn on every event pushed so far and frees their slots
+        template <typename Function>
+        void Drain(Function fn)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_acquire);
+            for (; t != h; t++)
+                fn(events[t % CAPACITY]);
+            tail.store(t, std::memory_order_release);
+        }
+
+    private:
+        alignas(64) std::atomic<uint32_t> head{ 0 };
+        alignas(64) std::atomic<uint32_t> tail{ 0 };
+        Event events[CAPACITY];
+    };
+
+    inline EventRing rings[MAX_THREADS];
+    inline std::atomic<uint64_t> dropped{ 0 };
+
+    // A thread claims a ring with its first scope and gives it back when it ends; events it left
+    // behind are still drained, the next owner only appends after them.
+    struct ThreadState
+    {
+        int Ring = -1;
+        int Depth = 0;
+
+        ~ThreadState()
+        {
+            if (Ring >= 0)
+                rings[Ring].Claimed.store(false, std::memory_order_release);
+        }
+    };
+    inline thread_local ThreadState threadState;
+
+    inline int threadRing()
+    {
+        for (int i = 0; threadState.Ring < 0 && i < MAX_THREADS; i++)
+        {
+            bool expected = false;
+            if (rings[i].Claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                threadState.Ring = i;
+        }
+        return threadState.Ring;
+    }
+
+    inline void record(const char* name, int64_t start, int64_t end, int depth)
+    {
+        int ring = threadRing();
+        if (ring < 0 || !rings[ring].Push({ name, start, end, ring, depth }))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// times the enclosing block on the calling thread, usable on any thread
+class CpuScope
+{
+public:
+    explicit CpuScope(const char* name) : name(name), depth(profiling::threadState.Depth++), start(profiling::now()) {}
+
+    ~CpuScope()
+    {
+        profiling::threadState.Depth--;
+        profiling::record(name, start, profiling::now(), depth);
+    }
+
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+    const char* name;
+    int depth;
+    int64_t start;
+};
+
+class FrameProfiler
+{
+public:
+    // frames timestamps may stay in flight before we have to wait for them
+    static const int LATENCY = 4;
+    // frames the averages and percentiles are taken over
+    static const int HISTORY = 240;
+    // frames of events kept for the trace
+    static const int TRACE_FRAMES = 300;
+
+    // the last HISTORY per-frame totals of a scope, in milliseconds
+    struct Timing
+    {
+        std::vector<float> Samples;
+        int Next = 0;
+
+        void Add(float milliseconds)
+        {
+            if ((int)Samples.size() < HISTORY)
+                Samples.push_back(milliseconds);
+            else
+                Samples[Next] = milliseconds;
+            Next = (Next + 1) % HISTORY;
+        }
+
+        float Average() const
+        {
+            float sum = 0.0f;
+            for (float sample : Samples)
+                sum += sample;
+            return Samples.empty() ? 0.0f : sum / Samples.size();
+        }
+
+        // nearest rank, percent in [0, 100]
+        float Percentile(float percent) const
+        {
+            if (Samples.empty())
+                return 0.0f;
+            std::vector<float> sorted(Samples);
+            size_t rank = std::min(sorted.size() - 1, (size_t)(percent / 100.0f * sorted.size()));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            return sorted[rank];
+        }
+    };
+
+    struct Scope
+    {
+        std::string Name;
+        int Depth = 0;
+        Timing Cpu, Gpu;
+        int64_t Offset = 0;             // start within the frame the last time it ran, orders the report
+        uint64_t LastFrame = 0;         // frame it last ran in
+        double CpuFrame = 0.0, GpuFrame = 0.0;
+        bool CpuHit = false, GpuHit = false;
+    };
+
+    uint64_t Frames;
+    std::vector<Scope> Scopes;
+
+    // claims the first ring for the calling thread, which must be the one with the OpenGL context
+    FrameProfiler() : Frames(0), current(0), frameMarker(-1), frameStart(0), mainRing(profiling::threadRing()) {}
+
+    ~FrameProfiler()
+    {
+        for (GpuFrame& frame : frames)
+            if (!frame.Queries.empty())
+                glDeleteQueries((GLsizei)frame.Queries.size(), frame.Queries.data());
+    }
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // opens the frame scope, on the CPU and the GPU
+    void BeginFrame()
+    {
+        GpuFrame& frame = frames[current];
+        // the slot is about to be reused, its timestamps have to be collected first
+        if (frame.Pending)
+            read(frame);
+        frame.Markers.clear();
+        frame.Used = 0;
+        frame.Frame = Frames;
+
+        // maps GL_TIMESTAMP onto the CPU clock; the GPU clock drifts slowly, so once a frame will do
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        frameStart = profiling::now();
+        frame.Offset = frameStart - gpuNow;
+
+        profiling::threadState.Depth++;
+        frameMarker = BeginGpu("frame");
+    }
+
+    // closes the frame scope, drains the rings and collects the timestamps that are available
+    void EndFrame()
+    {
+        EndGpu(frameMarker);
+        profiling::threadState.Depth--;
+        profiling::record("frame", frameStart, profiling::now(), 0);
+        frames[current].Pending = true;
+        current = (current + 1) % LATENCY;
+
+        for (profiling::EventRing& ring : profiling::rings)
+            ring.Drain([&](const profiling::Event& event) {
+                add(event, false, frameStart);
+                cpuTrace.push_back(event);
+            });
+        finish(false);
+
+        for (int i = 0; i < LATENCY; i++)
+        {
+            GpuFrame& frame = frames[(current + i) % LATENCY];
+            if (!frame.Pending)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(frame.Queries[frame.Used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            read(frame);
+        }
+
+        frameStarts.push_back(frameStart);
+        if (frameStarts.size() > TRACE_FRAMES)
+            frameStarts.pop_front();
+        trim(cpuTrace);
+        trim(gpuTrace);
+        Frames++;
+    }
+
+    // writes a timestamp before the commands of a scope, returns the marker to end it with
+    int BeginGpu(const char* name)
+    {
+        GpuFrame& frame = frames[current];
+        frame.Markers.push_back({ name, gpuDepth++, query(frame), -1 });
+        return int(frame.Markers.size()) - 1;
+    }
+
+    void EndGpu(int marker)
+    {
+        GpuFrame& frame = frames[current];
+        gpuDepth--;
+        frame.Markers[marker].End = query(frame);
+    }
+
+    // rolling average and percentiles of every scope that ran in the last HISTORY frames, nested
+    // scopes indented under the scope around them
+    void Print(std::ostream& out) const
+    {
+        std::vector<const Scope*> recent;
+        for (const Scope& scope : Scopes)
+            if (scope.LastFrame + HISTORY >= Frames)
+                recent.push_back(&scope);
+        std::stable_sort(recent.begin(), recent.end(), [](const Scope* a, const Scope* b) {
+            return a->Offset != b->Offset ? a->Offset < b->Offset : a->Depth < b->Depth;
+        });
+
+        out << std::fixed << std::setprecision(3)
+            << "profiler: last " << std::min<uint64_t>(Frames, HISTORY) << " frames, ms per frame as average / p50 / p95 / p99, "
+            << profiling::dropped.load() << " scopes dropped" << std::endl
+            << std::left << std::setw(24) << "  scope" << std::setw(44) << "CPU" << "GPU" << std::endl;
+        for (const Scope* scope : recent)
+        {
+            out << std::setw(24) << ("  " + std::string(2 * scope->Depth, ' ') + scope->Name)
+                << std::setw(44) << describe(scope->Cpu) + "  " << describe(scope->Gpu) << std::endl;
+        }
+        out << std::right << std::defaultfloat << std::setprecision(6);
+    }
+
+    // writes the events of the last TRACE_FRAMES frames in the Chrome trace event format
+    bool ExportTrace(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() {
+            if (!first)
+                file << ",\n";
+            first = false;
+        };
+        bool used[profiling::GPU_THREAD + 1] = {};
+        for (const std::deque<profiling::Event>* trace : { &cpuTrace, &gpuTrace })
+            for (const profiling::Event& event : *trace)
+                used[event.Thread] = true;
+        for (int thread = 0; thread <= profiling::GPU_THREAD; thread++)
+        {
+            if (!used[thread])
+                continue;
+            separator();
+            std::string name = thread == profiling::GPU_THREAD ? "GPU" : thread == mainRing ? "main" : "worker " + std::to_string(thread);
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"" << name << "\"}}";
+        }
+        int64_t cutoff = frameStarts.empty() ? 0 : frameStarts.front();
+        for (const std::deque<profiling::Event>* trace : { &cpuTrace, &gpuTrace })
+        {
+            for (const profiling::Event& event : *trace)
+            {
+                if (event.End < cutoff)
+                    continue;
+                separator();
+                file << "{\"name\":\"" << event.Name << "\",\"cat\":\"" << (event.Thread == profiling::GPU_THREAD ? "gpu" : "cpu")
+                     << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.Thread
+                     << ",\"ts\":" << event.Start / 1000.0 << ",\"dur\":" << (event.End - event.Start) / 1000.0 << "}";
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "profiler: wrote " << frameStarts.size() << " frames to " << path << std::endl;
+        return true;
+    }
+
+private:
+    struct Marker
+    {
+        const char* Name;
+        int Depth;
+        int Begin, End;                 // indices into the frame's queries
+    };
+
+    struct GpuFrame
+    {
+        std::vector<GLuint> Queries;
+        std::vector<Marker> Markers;
+        int Used = 0;
+        bool Pending = false;
+        int64_t Offset = 0;             // CPU clock minus GPU clock when the frame began
+        uint64_t Frame = 0;
+    };
+
+    GpuFrame frames[LATENCY];
+    int current, frameMarker, gpuDepth = 0;
+    int64_t frameStart;
+    int mainRing;
+    std::deque<int64_t> frameStarts;
+    std::deque<profiling::Event> cpuTrace, gpuTrace;
+
+    // writes a timestamp into the next query object of the frame, making one when they ran out
+    int query(GpuFrame& frame)
+    {
+        if (frame.Used == (int)frame.Queries.size())
+        {
+            frame.Queries.push_back(0);
+            glGenQueries(1, &frame.Queries.back());
+        }
+        glQueryCounter(frame.Queries[frame.Used], GL_TIMESTAMP);
+        return frame.Used++;
+    }
+
+    void read(GpuFrame& frame)
+    {
+        std::vector<GLuint64> times(frame.Used);
+        for (int i = 0; i < frame.Used; i++)
+            glGetQueryObjectui64v(frame.Queries[i], GL_QUERY_RESULT, &times[i]);
+        int64_t start = (int64_t)times[frame.Markers[0].Begin] + frame.Offset;
+        for (const Marker& marker : frame.Markers)
+        {
+            profiling::Event event = { marker.Name, (int64_t)times[marker.Begin] + frame.Offset, (int64_t)times[marker.End] + frame.Offset,
+                                       profiling::GPU_THREAD, marker.Depth };
+            add(event, true, start);
+            gpuTrace.push_back(event);
+        }
+        finish(true);
+        frame.Pending = false;
+    }
+
+    Scope& find(const char* name)
+    {
+        for (Scope& scope : Scopes)
+            if (scope.Name == name)
+                return scope;
+        Scopes.emplace_back();
+        Scopes.back().Name = name;
+        return Scopes.back();
+    }
+
+    // adds an event to the current frame's total of its scope
+    void add(const profiling::Event& event, bool gpu, int64_t start)
+    {
+        Scope& scope = find(event.Name);
+        double milliseconds = (event.End - event.Start) / 1e6;
+        bool& hit = gpu ? scope.GpuHit : scope.CpuHit;
+        double& total = gpu ? scope.GpuFrame : scope.CpuFrame;
+        if (!hit)
+            total = 0.0;
+        total += milliseconds;
+        hit = true;
+        if (gpu)
+            return;
+        scope.LastFrame = Frames;
+        if (event.Thread == mainRing)
+        {
+            scope.Depth = event.Depth;
+            scope.Offset = event.Start - start;
+        }
+    }
+
+    // turns the totals of the frame just added into samples of the scopes that ran in it
+    void finish(bool gpu)
+    {
+        for (Scope& scope : Scopes)
+        {
+            bool& hit = gpu ? scope.GpuHit : scope.CpuHit;
+            if (!hit)
+                continue;
+            if (gpu)
+                scope.Gpu.Add((float)scope.GpuFrame);
+            else
+                scope.Cpu.Add((float)scope.CpuFrame);
+            hit = false;
+        }
+    }
+
+    void trim(std::deque<profiling::Event>& trace)
+    {
+        while (!trace.empty() && trace.front().End < frameStarts.front())
+            trace.pop_front();
+    }
+
+    static std::string describe(const Timing& timing)
+    {
+        if (timing.Samples.empty())
+            return "-";
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(3) << timing.Average() << " / " << timing.Percentile(50.0f) << " / "
+             << timing.Percentile(95.0f) << " / " << timing.Percentile(99.0f);
+        return text.str();
+    }
+};
+
+// times the enclosing block of the render loop on the CPU and on the GPU, main thread only,
+// between BeginFrame() and EndFrame()
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler& profiler, const char* name) : profiler(profiler), cpu(name), marker(profiler.BeginGpu(name)) {}
+
+    ~ProfileScope()
+    {
+        profiler.EndGpu(marker);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler;
+    CpuScope cpu;
+    int marker;
+};
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <glad/glad.h>
+
+// Asynchronous OpenGL query object (GL_PRIMITIVES_GENERATED, GL_SAMPLES_PASSED, GL_TIME_ELAPSED, ...).
+// A small ring of query objects is cycled every frame, and results are read back a few frames later
+// once the GPU has made them available, so reading statistics never stalls the pipeline.
+class AsyncQuery
+{
+public:
+    // number of frames a result may stay in flight before we have to wait for it
+    static const int LATENCY = 4;
+
+    GLenum Target;
+    // most recent result that became available, and whether there is one yet
+    GLuint64 Result;
+    bool HasResult;
+
+    // creates the query objects, needs a current OpenGL context
+    AsyncQuery(GLenum target) : Target(target), Result(0), HasResult(false), current(0)
+    {
+        glGenQueries(LATENCY, ids);
+        for (int i = 0; i < LATENCY; i++)
+            pending[i] = false;
+    }
+
+    ~AsyncQuery()
+    {
+        glDeleteQueries(LATENCY, ids);
+    }
+
+    AsyncQuery(const AsyncQuery&) = delete;
+    AsyncQuery& operator=(const AsyncQuery&) = delete;
+
+    // starts counting into the next query object of the ring
+    void Begin()
+    {
+        // the slot is about to be reused, its old result has to be collected first
+        if (pending[current])
+            read(current);
+        glBeginQuery(Target, ids[current]);
+    }
+
+    // stops counting and picks up every result that is already available
+    void End()
+    {
+        glEndQuery(Target);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+        Collect();
+    }
+
+    // reads back finished queries, oldest first, without waiting on unfinished ones
+    void Collect()
+    {
+        for (int i = 0; i < LATENCY; i++)
+        {
+            int slot = (current + i) % LATENCY;
+            if (!pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(ids[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            read(slot);
+        }
+    }
+
+private:
+    GLuint ids[LATENCY];
+    bool pending[LATENCY];
+    int current;
+
+    void read(int slot)
+    {
+        glGetQueryObjectui64v(ids[slot], GL_QUERY_RESULT, &Result);
+        pending[slot] = false;
+        HasResult = true;
+    }
+};
+#endif
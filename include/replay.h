@@ -0,0 +1,245 @@
+#pragma once
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Recording and replay of the window's input. A recording is a compact binary file: a header with
+// the seed rand() was given, then one record per key, cursor or scroll event stamped with the
+// seconds since the recording started, and an end record with the length of the session. A replay
+// feeds the events back into the same callbacks at a fixed timestep, so the same frames see the
+// same input and the same random numbers on every run, and on any build that reads the file.
+//
+// Records are a type byte and a float time, followed by int16 key, int16 scancode, uint8 action and
+// uint8 mods for keys, or two floats for cursor positions and scroll offsets; all little endian.
+struct InputEvent
+{
+    enum Type : uint8_t
+    {
+        KEY = 1,
+        CURSOR = 2,
+        SCROLL = 3,
+        END = 4
+    };
+
+    Type Kind;
+    float Time;
+    int Key, Scancode, Action, Mods;
+    float X, Y;                         // cursor position or scroll offset
+};
+
+const char INPUT_RECORDING_MAGIC[4] = { 'C', 'G', 'I', 'R' };
+const uint32_t INPUT_RECORDING_VERSION = 1;
+
+class InputRecorder
+{
+public:
+    int Events;
+
+    InputRecorder() : Events(0), start(0.0), last(0.0) {}
+
+    ~InputRecorder()
+    {
+        Close(last);
+    }
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // starts a recording at the time now, in seconds of any clock the later calls share
+    bool Open(const std::string& path, uint32_t seed, double now)
+    {
+        file.open(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT_RECORDER::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        start = last = now;
+        file.write(INPUT_RECORDING_MAGIC, 4);
+        write(INPUT_RECORDING_VERSION);
+        write(seed);
+        return true;
+    }
+
+    bool IsOpen() const
+    {
+        return file.is_open();
+    }
+
+    void Key(double now, int key, int scancode, int action, int mods)
+    {
+        if (!begin(InputEvent::KEY, now))
+            return;
+        write((int16_t)key);
+        write((int16_t)scancode);
+        write((uint8_t)action);
+        write((uint8_t)mods);
+    }
+
+    void Cursor(double now, double x, double y)
+    {
+        if (!begin(InputEvent::CURSOR, now))
+            return;
+        write((float)x);
+        write((float)y);
+    }
+
+    void Scroll(double now, double x, double y)
+    {
+        if (!begin(InputEvent::SCROLL, now))
+            return;
+        write((float)x);
+        write((float)y);
+    }
+
+    // writes the end record with the length of the session
+    void Close(double now)
+    {
+        if (!begin(InputEvent::END, now))
+            return;
+        file.close();
+        std::cout << "input recorder: " << Events - 1 << " events over " << now - start << " s" << std::endl;
+    }
+
+private:
+    std::ofstream file;
+    double start, last;
+
+    template <typename T>
+    void write(T value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    bool begin(InputEvent::Type type, double now)
+    {
+        if (!file.is_open())
+            return false;
+        last = now;
+        write((uint8_t)type);
+        write((float)(now - start));
+        Events++;
+        return true;
+    }
+};
+
+class InputReplay
+{
+public:
+    uint32_t Seed;
+    float Duration;
+    std::vector<InputEvent> Events;
+    bool Delivering;                    // set while Deliver() calls back, to tell replayed input from live input
+
+    InputReplay() : Seed(0), Duration(0.0f), Delivering(false), next(0) {}
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        uint32_t version = 0;
+        file.read(magic, 4);
+        read(file, version);
+        read(file, Seed);
+        if (!file || std::memcmp(magic, INPUT_RECORDING_MAGIC, 4) != 0 || version != INPUT_RECORDING_VERSION)
+        {
+            std::cout << "ERROR::INPUT_REPLAY::NOT_A_RECORDING: " << path << std::endl;
+            return false;
+        }
+
+        Events.clear();
+        uint8_t type;
+        while (read(file, type))
+        {
+            InputEvent event = {};
+            event.Kind = (InputEvent::Type)type;
+            read(file, event.Time);
+            if (type == InputEvent::KEY)
+            {
+                int16_t key, scancode;
+                uint8_t action, mods;
+                read(file, key);
+                read(file, scancode);
+                read(file, action);
+                read(file, mods);
+                event.Key = key;
+                event.Scancode = scancode;
+                event.Action = action;
+                event.Mods = mods;
+            }
+            else if (type == InputEvent::CURSOR || type == InputEvent::SCROLL)
+            {
+                read(file, event.X);
+                read(file, event.Y);
+            }
+            else if (type != InputEvent::END)
+                break;
+            if (!file)
+                break;
+            if (type == InputEvent::END)
+            {
+                Duration = event.Time;
+                next = 0;
+                std::cout << "input replay: " << Events.size() << " events over " << Duration << " s, seed " << Seed << std::endl;
+                return true;
+            }
+            Events.push_back(event);
+        }
+        std::cout << "ERROR::INPUT_REPLAY::TRUNCATED: " << path << std::endl;
+        return false;
+    }
+
+    // calls onKey(key, scancode, action, mods), onCursor(x, y) and onScroll(x, y) for the events
+    // recorded up to a time, oldest first, and keeps track of the keys held down
+    template <typename KeyFunction, typename CursorFunction, typename ScrollFunction>
+    void Deliver(float time, KeyFunction onKey, CursorFunction onCursor, ScrollFunction onScroll)
+    {
+        Delivering = true;
+        for (; next < Events.size() && Events[next].Time <= time; next++)
+        {
+            const InputEvent& event = Events[next];
+            if (event.Kind == InputEvent::KEY)
+            {
+                // GLFW_RELEASE is 0, GLFW_PRESS and GLFW_REPEAT leave the key down
+                if (event.Action == 0)
+                    held.erase(event.Key);
+                else
+                    held.insert(event.Key);
+                onKey(event.Key, event.Scancode, event.Action, event.Mods);
+            }
+            else if (event.Kind == InputEvent::CURSOR)
+                onCursor(event.X, event.Y);
+            else
+                onScroll(event.X, event.Y);
+        }
+        Delivering = false;
+    }
+
+    bool KeyDown(int key) const
+    {
+        return held.count(key) != 0;
+    }
+
+    bool Finished(float time) const
+    {
+        return next == Events.size() && time >= Duration;
+    }
+
+private:
+    size_t next;
+    std::unordered_set<int> held;
+
+    template <typename T>
+    static bool read(std::ifstream& file, T& value)
+    {
+        return bool(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+};
+#endif
@@ -0,0 +1,196 @@
+#pragma once
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+// Omnidirectional shadow map of a light, kept as two depth cube maps. The static casters are
+// rendered into a cache only when the light moves or Invalidate() is called; every frame that has
+// dynamic casters copies the cache and draws just those casters over the copy, into the faces their
+// bounding spheres reach. Frames without dynamic casters sample the cache directly, so in steady
+// state the shadows cost one copy and a few small draws, or nothing at all.
+//
+// Receivers compare against hardware-filtered depth (samplerCubeShadow); the depth of a point is
+// that of the 90 degree perspective of the face it falls in, i.e. it follows the major axis.
+class CachedShadowMap
+{
+public:
+    static const int FACES = 6;
+
+    // draws casters into the bound face with the given light view and projection
+    using DrawFunction = std::function<void(const glm::mat4& view, const glm::mat4& projection)>;
+
+    int Size;
+    float NearZ, FarZ;
+    glm::vec3 Position;                 // the light the map was last rendered from
+
+    int StaticRenders;                  // times the cache was rebuilt
+    int DynamicFaces;                   // faces that received dynamic casters this frame
+
+    // creates both cube maps and a framebuffer per face, needs a current OpenGL context
+    CachedShadowMap(int size, int textureUnit, float nearZ, float farZ) : Size(size), NearZ(nearZ), FarZ(farZ), Position(0.0f),
+        StaticRenders(0), DynamicFaces(0), unit(textureUnit), staticValid(false), dynamicValid(false)
+    {
+        glGenTextures(2, textures);
+        for (int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, textures[i]);
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_DEPTH_COMPONENT24, size, size);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        glGenFramebuffers(2 * FACES, framebuffers);
+        for (int i = 0; i < 2; i++)
+        {
+            for (int face = 0; face < FACES; face++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i * FACES + face]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[i], 0);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                    std::cout << "ERROR::SHADOW::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~CachedShadowMap()
+    {
+        glDeleteFramebuffers(2 * FACES, framebuffers);
+        glDeleteTextures(2, textures);
+    }
+
+    CachedShadowMap(const CachedShadowMap&) = delete;
+    CachedShadowMap& operator=(const CachedShadowMap&) = delete;
+
+    // a static caster changed, the cache is rebuilt by the next Update()
+    void Invalidate()
+    {
+        staticValid = false;
+    }
+
+    // Starts a frame for a light at the given position: rebuilds the cache with the static casters
+    // if the light moved or the cache was invalidated, and drops last frame's dynamic casters.
+    // Returns whether the cache was rebuilt.
+    bool Update(const glm::vec3& position, const DrawFunction& drawStatic)
+    {
+        dynamicValid = false;
+        DynamicFaces = 0;
+        if (staticValid && position == Position)
+            return false;
+
+        Position = position;
+        render(0, glm::vec3(0.0f), 0.0f, drawStatic);
+        staticValid = true;
+        StaticRenders++;
+        return true;
+    }
+
+    // Draws dynamic casters, bounded by a sphere, over this frame's copy of the cache. The first
+    // call of a frame makes the copy; faces the sphere does not reach are skipped.
+    void DrawDynamic(const glm::vec3& center, float radius, const DrawFunction& draw)
+    {
+        if (!dynamicValid)
+        {
+            glCopyImageSubData(textures[0], GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, textures[1], GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, Size, Size, FACES);
+            dynamicValid = true;
+        }
+        DynamicFaces += render(1, center, radius, draw);
+    }
+
+    // binds the map this frame's receivers read and sets <name>Enabled, <name>Map, <name>Position and
+    // <name>Range on a shader that is in use
+    void Apply(Shader& shader, const std::string& name, bool enabled)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textures[dynamicValid ? 1 : 0]);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setBool(name + "Enabled", enabled);
+        shader.setInt(name + "Map", unit);
+        shader.setVec3(name + "Position", Position);
+        shader.setVec2(name + "Range", NearZ, FarZ);
+    }
+
+    // view of one cube face, with the axes OpenGL uses to look cube maps up
+    glm::mat4 FaceView(int face) const
+    {
+        static const glm::vec3 directions[FACES] = {
+            { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+            { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+        };
+        static const glm::vec3 ups[FACES] = {
+            { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+        };
+        return glm::lookAt(Position, Position + directions[face], ups[face]);
+    }
+
+    glm::mat4 FaceProjection() const
+    {
+        return glm::perspective(glm::radians(90.0f), 1.0f, NearZ, FarZ);
+    }
+
+private:
+    int unit;
+    unsigned int textures[2];               // the static cache, and the cache with this frame's dynamic casters
+    unsigned int framebuffers[2 * FACES];
+    bool staticValid, dynamicValid;
+
+    // draws into every face of one map, or only the faces a sphere reaches when radius > 0, and
+    // returns how many faces were drawn; the cache is cleared first, the copy keeps the cached depth
+    int render(int map, const glm::vec3& center, float radius, const DrawFunction& draw)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLint framebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        glViewport(0, 0, Size, Size);
+
+        glm::mat4 projection = FaceProjection();
+        int drawn = 0;
+        for (int face = 0; face < FACES; face++)
+        {
+            glm::mat4 view = FaceView(face);
+            if (radius > 0.0f && !reaches(view, center, radius))
+                continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[map * FACES + face]);
+            if (map == 0)
+                glClear(GL_DEPTH_BUFFER_BIT);
+            draw(view, projection);
+            drawn++;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return drawn;
+    }
+
+    // whether a sphere overlaps the 90 degree frustum of a face
+    bool reaches(const glm::mat4& view, const glm::vec3& center, float radius) const
+    {
+        glm::vec3 c = glm::vec3(view * glm::vec4(center, 1.0f));
+        float depth = -c.z;
+        if (depth + radius < NearZ || depth - radius > FarZ)
+            return false;
+        // the side planes are |x| = depth and |y| = depth, with unit normals (1, +-1) / sqrt(2)
+        float reach = radius * 1.41421356f;
+        return glm::abs(c.x) - depth <= reach && glm::abs(c.y) - depth <= reach;
+    }
+};
+#endif
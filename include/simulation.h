@@ -0,0 +1,248 @@
+#pragma once
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include "particles.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Hands snapshots from one producer thread to one consumer thread without locks. There are four
+// slots: the producer writes into one, one holds the latest published snapshot, and the consumer
+// keeps the two newest it has taken so it can interpolate between them. Publishing and taking a
+// snapshot each swap a slot index through a single atomic, so neither side ever waits; snapshots
+// the consumer was too slow to take are overwritten by newer ones.
+template <typename T>
+class SnapshotExchange
+{
+public:
+    SnapshotExchange(const T& initial) : back(0), previous(1), current(2), ready(3)
+    {
+        for (T& slot : slots)
+            slot = initial;
+    }
+
+    SnapshotExchange(const SnapshotExchange&) = delete;
+    SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+    // producer side: the slot to fill before Publish()
+    T& Back()
+    {
+        return slots[back];
+    }
+
+    void Publish()
+    {
+        back = ready.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // consumer side: takes the latest snapshot if one was published since the last call,
+    // the one taken before it becomes Previous()
+    bool Acquire()
+    {
+        if (!(ready.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        int taken = ready.exchange(previous, std::memory_order_acq_rel) & INDEX;
+        previous = current;
+        current = taken;
+        return true;
+    }
+
+    const T& Previous() const
+    {
+        return slots[previous];
+    }
+
+    const T& Current() const
+    {
+        return slots[current];
+    }
+
+private:
+    static const int INDEX = 3, FRESH = 4;
+
+    T slots[4];
+    int back;                           // producer only
+    int previous, current;              // consumer only
+    std::atomic<int> ready;             // slot index, FRESH until the consumer takes it
+};
+
+// everything the simulation owns, as of one tick
+struct SimulationState
+{
+    double Time = 0.0;                  // seconds of simulation time
+    float WindmillAngle = 0.0f;
+    std::vector<SnowParticle> Snow;
+    std::vector<LightParticle> Lights;
+};
+
+// Windmill rotation and the snow and light particles, advanced in fixed ticks so the result doesn't
+// depend on the frame rate. Started with Start(), the ticks run on a thread of their own against the
+// steady clock and overlap with rendering; otherwise the render thread steps them with AdvanceTo(),
+// which is what the fixed-timestep benchmark and input replay do so their frames stay reproducible.
+// Either way the render thread only reads snapshots, through Interpolate(), and hands the scene
+// switches and input over through SetControls() and NudgeWindmill().
+class Simulation
+{
+public:
+    static constexpr double TICK = 1.0 / 120.0;
+
+    std::atomic<int> Ticks;             // ticks run so far
+
+    Simulation(const SimulationState& initial, const SnowCollider& tree)
+        : Ticks(0), state(initial), tree(tree), snapshots(initial), windmillRotate(false), windmillSpeed(0.0f),
+          snowFalling(false), lightsMoving(false), windmillNudge(0.0f), running(false)
+    {
+    }
+
+    ~Simulation()
+    {
+        Stop();
+    }
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // runs the ticks on a new thread from now on, seeding its rand() first since some C runtimes
+    // keep rand()'s state per thread
+    void Start(unsigned int seed)
+    {
+        start = std::chrono::steady_clock::now();
+        running = true;
+        worker = std::thread([this, seed]
+        {
+            srand(seed);
+            while (running)
+            {
+                AdvanceTo(Now());
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(state.Time + TICK)));
+            }
+        });
+    }
+
+    void Stop()
+    {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool IsThreaded() const
+    {
+        return worker.joinable();
+    }
+
+    // seconds of the clock the simulation thread follows, since Start()
+    double Now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void SetControls(bool rotateWindmill, float windmillDegreesPerSecond, bool snow, bool lights)
+    {
+        windmillRotate = rotateWindmill;
+        windmillSpeed = windmillDegreesPerSecond;
+        snowFalling = snow;
+        lightsMoving = lights;
+    }
+
+    // turns the windmill by a number of degrees at the next tick
+    void NudgeWindmill(float degrees)
+    {
+        float nudge = windmillNudge.load();
+        while (!windmillNudge.compare_exchange_weak(nudge, nudge + degrees))
+            ;
+    }
+
+    // runs every tick due up to a time, publishing a snapshot after each; not to be called while
+    // the simulation thread runs, except by that thread
+    void AdvanceTo(double time)
+    {
+        // a simulation that fell far behind (a breakpoint, a long hitch) skips ahead instead of catching up
+        if (time - state.Time > 0.25)
+            state.Time = time - 0.25;
+        while (state.Time + TICK <= time)
+        {
+            tick();
+            snapshots.Back() = state;
+            snapshots.Publish();
+        }
+    }
+
+    // The scene as of time - TICK, interpolated between the two newest snapshots; running one tick
+    // behind keeps the time between them most of the time. Particles that moved further than their
+    // speed allows were respawned and are taken as they are in the newer snapshot.
+    void Interpolate(double time, float& windmillAngle, std::vector<SnowParticle>& snow, std::vector<LightParticle>& lights)
+    {
+        snapshots.Acquire();
+        const SimulationState& previous = snapshots.Previous();
+        const SimulationState& current = snapshots.Current();
+        float span = float(current.Time - previous.Time);
+        float alpha = span > 0.0f ? glm::clamp(float(time - TICK - previous.Time) / span, 0.0f, 1.0f) : 1.0f;
+
+        float turn = current.WindmillAngle - previous.WindmillAngle;
+        turn -= 360.0f * glm::round(turn / 360.0f);
+        windmillAngle = previous.WindmillAngle + turn * alpha;
+
+        snow.resize(current.Snow.size());
+        for (size_t i = 0; i < snow.size(); i++)
+        {
+            snow[i] = current.Snow[i];
+            snow[i].position = interpolatePosition(previous.Snow[i].position, current.Snow[i].position, current.Snow[i].velocity, span, alpha);
+        }
+        lights.resize(current.Lights.size());
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            lights[i] = current.Lights[i];
+            lights[i].position = interpolatePosition(previous.Lights[i].position, current.Lights[i].position, current.Lights[i].velocity, span, alpha);
+        }
+    }
+
+private:
+    SimulationState state;
+    SnowCollider tree;
+    SnapshotExchange<SimulationState> snapshots;
+
+    // written by the render thread, read at every tick
+    std::atomic<bool> windmillRotate;
+    std::atomic<float> windmillSpeed;
+    std::atomic<bool> snowFalling;
+    std::atomic<bool> lightsMoving;
+    std::atomic<float> windmillNudge;
+
+    std::atomic<bool> running;
+    std::thread worker;
+    std::chrono::steady_clock::time_point start;
+
+    void tick()
+    {
+        CpuScope tickScope("simulation tick");
+        float dt = float(TICK);
+        float angle = state.WindmillAngle + windmillNudge.exchange(0.0f);
+        if (windmillRotate)
+            angle += windmillSpeed * dt;
+        state.WindmillAngle = angle - static_cast<int>(angle) + static_cast<int>(angle) % 360;
+        if (snowFalling)
+            updateSnowParticles(state.Snow, dt, tree);
+        if (lightsMoving)
+            updateLightParticles(state.Lights, dt);
+        state.Time += TICK;
+        Ticks++;
+    }
+
+    static glm::vec3 interpolatePosition(const glm::vec3& previous, const glm::vec3& current, const glm::vec3& velocity, float span, float alpha)
+    {
+        glm::vec3 move = current - previous;
+        float reach = glm::length(velocity) * span * 1.01f + 1e-5f;
+        return glm::dot(move, move) <= reach * reach ? previous + move * alpha : current;
+    }
+};
+#endif
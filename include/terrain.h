@@ -0,0 +1,133 @@
+#pragma once
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Heightfield of the terrain, a square grid of samples in [0, 1].
+// The terrain mesh itself is only a flat parameterized grid: the tessellation evaluation shader
+// displaces it by sampling this heightfield from an R32F texture, so the vertex data stays the same
+// no matter how detailed the heightfield is, and editing heights is a sub-texture update.
+class Heightmap
+{
+public:
+    unsigned int Size;
+    std::vector<float> Heights;
+    unsigned int Texture;
+
+    Heightmap(unsigned int size) : Size(size), Heights(size * size, 0.0f), Texture(0)
+    {
+    }
+
+    ~Heightmap()
+    {
+        if (Texture)
+            glDeleteTextures(1, &Texture);
+    }
+
+    Heightmap(const Heightmap&) = delete;
+    Heightmap& operator=(const Heightmap&) = delete;
+
+    float& At(int x, int z) { return Heights[z * Size + x]; }
+    float At(int x, int z) const { return Heights[z * Size + x]; }
+
+    // bilinear sample at grid coordinates in [0, 1], the grid corners are the corner samples;
+    // this is the same lookup terrain.tese.glsl does on the texture
+    float Sample(glm::vec2 grid) const
+    {
+        glm::vec2 p = glm::clamp(grid, 0.0f, 1.0f) * float(Size - 1);
+        int x0 = std::min(int(p.x), int(Size) - 2);
+        int z0 = std::min(int(p.y), int(Size) - 2);
+        float fx = p.x - x0;
+        float fz = p.y - z0;
+        float top = glm::mix(At(x0, z0), At(x0 + 1, z0), fx);
+        float bottom = glm::mix(At(x0, z0 + 1), At(x0 + 1, z0 + 1), fx);
+        return glm::mix(top, bottom, fz);
+    }
+
+    // fills the heightfield with Perlin noise, frequency is the number of noise cells across the whole grid;
+    // every further octave doubles the frequency and halves the amplitude
+    void GeneratePerlin(float frequency, int octaves)
+    {
+        float total = 0.0f;
+        for (int i = 0; i < octaves; i++)
+            total += 1.0f / float(1 << i);
+
+        for (unsigned int z = 0; z < Size; z++)
+        {
+            for (unsigned int x = 0; x < Size; x++)
+            {
+                glm::vec2 p = glm::vec2(x, z) / float(Size - 1) * frequency;
+                float noise = 0.0f;
+                for (int i = 0; i < octaves; i++)
+                    noise += glm::perlin(p * float(1 << i)) / float(1 << i);
+                At(x, z) = noise / total / 2 + 0.5f;
+            }
+        }
+    }
+
+    // box filter over (2 * radius + 1)^2 samples, clipped at the borders
+    void Smooth(int radius)
+    {
+        std::vector<float> smoothed(Heights.size());
+        for (int z = 0; z < int(Size); z++)
+        {
+            for (int x = 0; x < int(Size); x++)
+            {
+                float sum = 0.0f;
+                int count = 0;
+                for (int nz = std::max(z - radius, 0); nz <= std::min(z + radius, int(Size) - 1); nz++)
+                {
+                    for (int nx = std::max(x - radius, 0); nx <= std::min(x + radius, int(Size) - 1); nx++)
+                    {
+                        sum += At(nx, nz);
+                        count++;
+                    }
+                }
+                smoothed[z * Size + x] = sum / count;
+            }
+        }
+        Heights.swap(smoothed);
+    }
+
+    // creates the texture holding the heightfield, needs a current OpenGL context
+    void Upload()
+    {
+        glGenTextures(1, &Texture);
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, Size, Size);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        Update(0, 0, Size, Size);
+    }
+
+    // copies a rectangle of edited samples to the texture, the rest of it is left alone
+    void Update(int x, int z, int width, int height)
+    {
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, Size);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, z, width, height, GL_RED, GL_FLOAT, &Heights[z * Size + x]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+// maps grid coordinates in [0, 1] onto the terrain disk and lifts them to the heightfield,
+// the CPU side of what terrain.vert.glsl and terrain.tese.glsl do
+inline glm::vec3 terrainPosition(const Heightmap& heightmap, glm::vec2 grid)
+{
+    glm::vec2 r = grid * 2.0f - 1.0f;
+    float x = r.x * glm::sqrt(1.0f - r.y * r.y / 2.0f) * 0.5f;
+    float z = r.y * glm::sqrt(1.0f - r.x * r.x / 2.0f) * 0.5f;
+    return glm::vec3(x, heightmap.Sample(grid), z);
+}
+#endif
@@ -0,0 +1,380 @@
+#pragma once
+#ifndef TERRAIN_STREAM_H
+#define TERRAIN_STREAM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "tiles.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct TerrainStreamStats
+{
+    unsigned int ResidentTiles;  // tiles holding a layer of the GPU pool
+    unsigned int PoolSize;
+    unsigned int WantedTiles;    // tiles inside the streaming radius this frame
+    unsigned int PendingTiles;   // wanted tiles still on their way from disk
+    unsigned long long Faults;   // tiles found not resident when they came into the radius
+    unsigned long long Loads;    // tiles paged in from the mapped file
+    unsigned long long Evictions;
+    unsigned long long BytesRead;
+};
+
+// Out-of-core terrain made of heightfield tiles streamed from a memory-mapped dataset (see tiles.h).
+// Every frame the tiles around the camera are requested; a background thread pages them in from
+// the mapping, and the render thread uploads finished tiles into a fixed pool of texture array layers,
+// evicting the least recently wanted tile when the pool is full. Only resident tiles are drawn.
+class TerrainStream
+{
+public:
+    TileDatasetHeader Header;
+    glm::vec3 Origin;   // world position of the corner of tile (0, 0)
+    float Radius;       // tiles whose centre is closer than this to the camera are kept resident
+
+    // maps the dataset and creates the texture pool, needs a current OpenGL context
+    TerrainStream(const char* path, unsigned int poolSize, float radius)
+        : Origin(0.0f), Radius(radius), poolSize(poolSize), textureArray(0), VAO(0), VBO(0), EBO(0), indexCount(0),
+          faults(0), evictions(0), loading(-1), pending(0), stop(false), loads(0), bytesRead(0)
+    {
+        std::memset(&Header, 0, sizeof(Header));
+        if (!file.Open(path) || file.Size < sizeof(TileDatasetHeader))
+        {
+            std::cout << "ERROR::TERRAIN_STREAM::FILE_NOT_FOUND: " << path << std::endl;
+            file.Close();
+            return;
+        }
+        std::memcpy(&Header, file.Data, sizeof(Header));
+        if (!Header.Valid() || file.Size < Header.TileOffset(0, Header.TilesZ))
+        {
+            std::cout << "ERROR::TERRAIN_STREAM::INVALID_DATASET: " << path << std::endl;
+            std::memset(&Header, 0, sizeof(Header));
+            file.Close();
+            return;
+        }
+
+        glGenTextures(1, &textureArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16, Header.TileSize, Header.TileSize, poolSize);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        for (unsigned int i = 0; i < poolSize; i++)
+            freeLayers.push_back(poolSize - 1 - i);
+
+        setupGrid();
+        worker = std::thread(&TerrainStream::workerLoop, this);
+    }
+
+    ~TerrainStream()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+        if (textureArray)
+        {
+            glDeleteTextures(1, &textureArray);
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+    }
+
+    TerrainStream(const TerrainStream&) = delete;
+    TerrainStream& operator=(const TerrainStream&) = delete;
+
+    bool IsOpen() const
+    {
+        return file.Data != nullptr;
+    }
+
+    // world size of the whole dataset on the x and z axes
+    glm::vec2 Extent() const
+    {
+        return glm::vec2(Header.TilesX, Header.TilesZ) * Header.TileExtent;
+    }
+
+    // requests the tiles around the camera and uploads at most maxUploads tiles that finished loading
+    void Update(glm::vec3 cameraPos, unsigned int maxUploads = 8)
+    {
+        if (!IsOpen())
+            return;
+
+        // tiles inside the radius, nearest first, no more than the pool can hold
+        std::vector<std::pair<float, int>> candidates;
+        glm::vec2 camera = (glm::vec2(cameraPos.x, cameraPos.z) - glm::vec2(Origin.x, Origin.z)) / Header.TileExtent;
+        float radius = Radius / Header.TileExtent;
+        int x0 = std::max(int(glm::floor(camera.x - radius)), 0);
+        int x1 = std::min(int(glm::ceil(camera.x + radius)), int(Header.TilesX) - 1);
+        int z0 = std::max(int(glm::floor(camera.y - radius)), 0);
+        int z1 = std::min(int(glm::ceil(camera.y + radius)), int(Header.TilesZ) - 1);
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                float distance = glm::length(glm::vec2(x + 0.5f, z + 0.5f) - camera);
+                if (distance < radius)
+                    candidates.push_back({ distance, z * int(Header.TilesX) + x });
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        if (candidates.size() > poolSize)
+            candidates.resize(poolSize);
+
+        wanted.clear();
+        std::vector<int> missing;
+        for (auto& candidate : candidates)
+        {
+            int tile = candidate.second;
+            wanted.push_back(tile);
+            auto it = resident.find(tile);
+            if (it != resident.end())
+                lru.splice(lru.begin(), lru, it->second.Position);
+            else
+                missing.push_back(tile);
+        }
+        for (int tile : missing)
+            if (std::find(lastMissing.begin(), lastMissing.end(), tile) == lastMissing.end())
+                faults++;
+        lastMissing = missing;
+
+        std::vector<LoadedTile> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(loaded);
+
+            // requests for tiles that left the radius are dropped, the rest is loaded nearest first
+            requests.clear();
+            for (int tile : missing)
+            {
+                bool inFlight = tile == loading;
+                for (auto& done : finished)
+                    inFlight = inFlight || done.Tile == tile;
+                if (!inFlight)
+                    requests.push_back(tile);
+            }
+            pending = (unsigned int)missing.size();
+        }
+        wake.notify_one();
+
+        unsigned int uploads = 0;
+        for (auto& done : finished)
+        {
+            if (resident.count(done.Tile) || std::find(wanted.begin(), wanted.end(), done.Tile) == wanted.end())
+                continue;
+            if (uploads == maxUploads)
+            {
+                // over this frame's upload budget, keep it for the next frame
+                std::lock_guard<std::mutex> lock(mutex);
+                loaded.push_back(std::move(done));
+                continue;
+            }
+            upload(done);
+            uploads++;
+        }
+    }
+
+    // draws every wanted tile that is resident, the shader samples heights from "heightTiles"
+    void Draw(Shader& shader)
+    {
+        if (!IsOpen())
+            return;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        shader.setInt("heightTiles", 0);
+        shader.setFloat("tileExtent", Header.TileExtent);
+        shader.setFloat("heightScale", Header.HeightScale);
+
+        glBindVertexArray(VAO);
+        for (int tile : wanted)
+        {
+            auto it = resident.find(tile);
+            if (it == resident.end())
+                continue;
+            int x = tile % Header.TilesX;
+            int z = tile / Header.TilesX;
+            shader.setVec3("tileOrigin", Origin + glm::vec3(x, 0.0f, z) * Header.TileExtent);
+            shader.setInt("layer", it->second.Layer);
+            glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_SHORT, 0);
+        }
+        glBindVertexArray(0);
+    }
+
+    TerrainStreamStats Stats()
+    {
+        TerrainStreamStats stats;
+        stats.ResidentTiles = (unsigned int)resident.size();
+        stats.PoolSize = poolSize;
+        stats.WantedTiles = (unsigned int)wanted.size();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.PendingTiles = pending;
+        }
+        stats.Faults = faults;
+        stats.Loads = loads;
+        stats.Evictions = evictions;
+        stats.BytesRead = bytesRead;
+        return stats;
+    }
+
+private:
+    struct Slot
+    {
+        int Layer;
+        std::list<int>::iterator Position;
+    };
+
+    struct LoadedTile
+    {
+        int Tile;
+        std::vector<uint16_t> Heights;
+    };
+
+    // vertices of the tile mesh, fewer than the tile's samples when tiles are large
+    static constexpr unsigned int MAX_GRID = 64;
+
+    MappedFile file;
+    unsigned int poolSize;
+    unsigned int textureArray;
+    unsigned int VAO, VBO, EBO;
+    unsigned int indexCount;
+
+    // render thread only
+    std::vector<int> wanted;
+    std::vector<int> lastMissing;
+    std::unordered_map<int, Slot> resident;
+    std::list<int> lru;     // resident tiles, most recently wanted first
+    std::vector<int> freeLayers;
+    unsigned long long faults;
+    unsigned long long evictions;
+
+    // shared with the worker, guarded by mutex
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<int> requests;
+    std::vector<LoadedTile> loaded;
+    int loading;
+    unsigned int pending;
+    bool stop;
+    std::atomic<unsigned long long> loads;
+    std::atomic<unsigned long long> bytesRead;
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this] { return stop || !requests.empty(); });
+            if (stop)
+                return;
+            loading = requests.front();
+            requests.erase(requests.begin());
+            lock.unlock();
+            CpuScope loadScope("terrain tile load");
+
+            // copying out of the mapping is where the page faults happen, off the render thread;
+            // afterwards the mapped pages are released so the dataset never piles up in memory
+            LoadedTile tile;
+            tile.Tile = loading;
+            size_t offset = Header.TileOffset(loading % Header.TilesX, loading / Header.TilesX);
+            tile.Heights.resize(Header.TileBytes() / sizeof(uint16_t));
+            std::memcpy(tile.Heights.data(), file.Data + offset, Header.TileBytes());
+            file.Release(offset, Header.TileBytes());
+            loads++;
+            bytesRead += Header.TileBytes();
+
+            lock.lock();
+            loaded.push_back(std::move(tile));
+            loading = -1;
+        }
+    }
+
+    void upload(LoadedTile& tile)
+    {
+        int layer;
+        if (!freeLayers.empty())
+        {
+            layer = freeLayers.back();
+            freeLayers.pop_back();
+        }
+        else
+        {
+            // wanted tiles never exceed the pool, so the least recently wanted tile is not wanted now
+            int victim = lru.back();
+            lru.pop_back();
+            layer = resident[victim].Layer;
+            resident.erase(victim);
+            evictions++;
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, Header.TileSize, Header.TileSize, 1, GL_RED, GL_UNSIGNED_SHORT, tile.Heights.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        lru.push_front(tile.Tile);
+        resident[tile.Tile] = { layer, lru.begin() };
+    }
+
+    // one flat grid in [0, 1] shared by all tiles, rows drawn as strips separated by primitive restart
+    void setupGrid()
+    {
+        unsigned int cells = std::min(Header.TileSize - 1, MAX_GRID);
+        std::vector<float> vertices;
+        std::vector<unsigned short> indices;
+        for (unsigned int z = 0; z <= cells; z++)
+        {
+            for (unsigned int x = 0; x <= cells; x++)
+            {
+                vertices.push_back(float(x) / cells);
+                vertices.push_back(float(z) / cells);
+            }
+        }
+        for (unsigned int z = 0; z < cells; z++)
+        {
+            for (unsigned int x = 0; x <= cells; x++)
+            {
+                indices.push_back(z * (cells + 1) + x);
+                indices.push_back((z + 1) * (cells + 1) + x);
+            }
+            indices.push_back(0xFFFF);
+        }
+        indexCount = (unsigned int)indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef TILES_H
+#define TILES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+// glad already defined APIENTRY as __stdcall, windows.h redefines it to the same thing through WINAPI
+#undef APIENTRY
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout of a tiled heightfield dataset on disk:
+// the header, followed by TilesX * TilesZ tiles in row-major order, each one TileSize * TileSize
+// 16-bit heights (0 .. 65535 maps to 0 .. HeightScale). Neighbouring tiles repeat their shared
+// border samples, so every tile can be sampled on its own without seams.
+struct TileDatasetHeader
+{
+    char Magic[4];        // "TILE"
+    uint32_t TileSize;    // samples per tile side
+    uint32_t TilesX;
+    uint32_t TilesZ;
+    float TileExtent;     // world units covered by one tile
+    float HeightScale;    // world units of the highest height
+
+    bool Valid() const
+    {
+        return std::memcmp(Magic, "TILE", 4) == 0 && TileSize >= 2 && TilesX > 0 && TilesZ > 0;
+    }
+
+    size_t TileBytes() const
+    {
+        return size_t(TileSize) * TileSize * sizeof(uint16_t);
+    }
+
+    size_t TileOffset(uint32_t x, uint32_t z) const
+    {
+        return sizeof(TileDatasetHeader) + (size_t(z) * TilesX + x) * TileBytes();
+    }
+};
+
+// Read-only memory mapping of a whole file. Nothing is read up front,
+// the OS pages the file in when the mapping is touched.
+class MappedFile
+{
+public:
+    const unsigned char* Data;
+    size_t Size;
+
+    MappedFile() : Data(nullptr), Size(0)
+    {
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+        Data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        Size = Data ? size_t(size.QuadPart) : 0;
+#else
+        file = open(path, O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        if (fstat(file, &info) != 0 || info.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+        void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+        Data = view == MAP_FAILED ? nullptr : (const unsigned char*)view;
+        Size = Data ? size_t(info.st_size) : 0;
+#endif
+        if (!Data)
+            Close();
+        return Data != nullptr;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (Data)
+            UnmapViewOfFile(Data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (Data)
+            munmap((void*)Data, Size);
+        if (file >= 0)
+            close(file);
+        file = -1;
+#endif
+        Data = nullptr;
+        Size = 0;
+    }
+
+    // tells the OS a range is no longer needed, so its pages can be dropped instead of staying resident
+    void Release(size_t offset, size_t length)
+    {
+#ifdef _WIN32
+        // Windows has no per-range hint for file views, the working set trimmer takes care of it
+        (void)offset;
+        (void)length;
+#else
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t begin = (offset + page - 1) / page * page;
+        size_t end = (offset + length) / page * page;
+        if (end > begin)
+            madvise((void*)(Data + begin), end - begin, MADV_DONTNEED);
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int file = -1;
+#endif
+};
+#endif
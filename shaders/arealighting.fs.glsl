@@ -1,5 +1,9 @@
 #version 330 core
-out vec4 FragColor;
+// the lit colour, or the octahedral normal when filling the G-buffer, or the weighted colour sum
+// with weighted blended transparency, whose revealage factor goes to the second target
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 GAlbedo;
+layout (location = 2) out vec4 GMaterial;
 
 in vec3 Normal;
 in vec3 FragPos;
@@ -13,7 +17,57 @@ uniform float metallic;
 uniform float roughness;
 uniform float specular;
 
+// analytic rectangular area light with linearly transformed cosines, replaces the point light grid
+uniform bool useLTC;
+uniform sampler2D ltc1;
+uniform sampler2D ltc2;
+uniform float ltcTableSize;
+uniform vec3 areaLightCorners[4];
+uniform vec3 areaLightRadiance;
+
+// clustered point lights: clusterLights holds two texels per light (position and radius, colour),
+// clusterGrid the first entry and count of each cluster's run in clusterIndices
+uniform bool useClusters;
+uniform int clusterLightCount;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthRange;
+uniform float clusterSliceScale;
+
+// shadows of the area light, from its centre
+uniform bool areaShadowEnabled;
+uniform samplerCubeShadow areaShadowMap;
+uniform vec3 areaShadowPosition;
+uniform vec2 areaShadowRange;
+
+// deferred shading: the G-buffer pass stores the surface instead of lighting it, the lighting pass
+// draws a full-screen triangle and lights whatever the G-buffer holds under each pixel
+uniform bool writeGBuffer;
+uniform bool readGBuffer;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+// weighted blended order-independent transparency, see include/oit.h
+uniform bool weightedBlended;
+
+// the surface being lit, from the inputs and material uniforms or from the G-buffer
+vec3 surfacePos;
+vec4 surfaceAlbedo;
+float surfaceMetallic;
+float surfaceRoughness;
+float surfaceSpecular;
+float surfaceDepth;     // window space, as in gl_FragCoord.z
+
 const float PI = 3.14159265359;
+// must match ClusteredLights in include/clustered.h
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
 
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
 {
@@ -54,43 +108,307 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
     return ggx1 * ggx2;
 }
 
+// integral of the cosine over one edge of a spherical polygon, with a rational fit of theta / sin(theta)
+float integrateEdge(vec3 v1, vec3 v2)
+{
+    float x = dot(v1, v2);
+    float y = abs(x);
+    float a = 0.8543985 + (0.4965155 + 0.0145206 * y) * y;
+    float b = 3.4175940 + (4.1616724 + y) * y;
+    float v = a / b;
+    float thetaSinTheta = (x > 0.0) ? v : 0.5 * inversesqrt(max(1.0 - x * x, 1e-7)) - v;
+    return cross(v1, v2).z * thetaSinTheta;
+}
+
+// clips the quad L[0..3] against the z = 0 horizon, leaving n (0, 3, 4 or 5) vertices
+void clipQuadToHorizon(inout vec3 L[5], out int n)
+{
+    int config = 0;
+    if (L[0].z > 0.0) config += 1;
+    if (L[1].z > 0.0) config += 2;
+    if (L[2].z > 0.0) config += 4;
+    if (L[3].z > 0.0) config += 8;
+
+    n = 0;
+    if (config == 1) {
+        n = 3;
+        L[1] = -L[1].z * L[0] + L[0].z * L[1];
+        L[2] = -L[3].z * L[0] + L[0].z * L[3];
+    } else if (config == 2) {
+        n = 3;
+        L[0] = -L[0].z * L[1] + L[1].z * L[0];
+        L[2] = -L[2].z * L[1] + L[1].z * L[2];
+    } else if (config == 3) {
+        n = 4;
+        L[2] = -L[2].z * L[1] + L[1].z * L[2];
+        L[3] = -L[3].z * L[0] + L[0].z * L[3];
+    } else if (config == 4) {
+        n = 3;
+        L[0] = -L[3].z * L[2] + L[2].z * L[3];
+        L[1] = -L[1].z * L[2] + L[2].z * L[1];
+    } else if (config == 6) {
+        n = 4;
+        L[0] = -L[0].z * L[1] + L[1].z * L[0];
+        L[3] = -L[3].z * L[2] + L[2].z * L[3];
+    } else if (config == 7) {
+        n = 5;
+        L[4] = -L[3].z * L[0] + L[0].z * L[3];
+        L[3] = -L[3].z * L[2] + L[2].z * L[3];
+    } else if (config == 8) {
+        n = 3;
+        L[0] = -L[0].z * L[3] + L[3].z * L[0];
+        L[1] = -L[2].z * L[3] + L[3].z * L[2];
+        L[2] = L[3];
+    } else if (config == 9) {
+        n = 4;
+        L[1] = -L[1].z * L[0] + L[0].z * L[1];
+        L[2] = -L[2].z * L[3] + L[3].z * L[2];
+    } else if (config == 11) {
+        n = 5;
+        L[4] = L[3];
+        L[3] = -L[2].z * L[3] + L[3].z * L[2];
+        L[2] = -L[2].z * L[1] + L[1].z * L[2];
+    } else if (config == 12) {
+        n = 4;
+        L[1] = -L[1].z * L[2] + L[2].z * L[1];
+        L[0] = -L[0].z * L[3] + L[3].z * L[0];
+    } else if (config == 13) {
+        n = 5;
+        L[4] = L[3];
+        L[3] = L[2];
+        L[2] = -L[1].z * L[2] + L[2].z * L[1];
+        L[1] = -L[1].z * L[0] + L[0].z * L[1];
+    } else if (config == 14) {
+        n = 5;
+        L[4] = -L[0].z * L[3] + L[3].z * L[0];
+        L[0] = -L[0].z * L[1] + L[1].z * L[0];
+    } else if (config == 15) {
+        n = 4;
+    }
+
+    if (n == 3)
+        L[3] = L[0];
+    if (n == 4)
+        L[4] = L[0];
+}
+
+// integral of the cosine distribution transformed by inverse(Minv) over the light polygon, times 2 pi
+float ltcEvaluate(vec3 N, vec3 V, vec3 P, mat3 Minv)
+{
+    // tangent frame with V in the xz plane; at normal incidence the lobe is round and any tangent will do
+    vec3 T1 = V - N * dot(V, N);
+    if (dot(T1, T1) < 1e-8)
+        T1 = abs(N.x) < 0.9 ? cross(N, vec3(1.0, 0.0, 0.0)) : cross(N, vec3(0.0, 1.0, 0.0));
+    T1 = normalize(T1);
+    vec3 T2 = cross(N, T1);
+    Minv = Minv * transpose(mat3(T1, T2, N));
+
+    vec3 L[5];
+    for (int i = 0; i < 4; i++)
+        L[i] = Minv * (areaLightCorners[i] - P);
+    L[4] = L[0];
+
+    int n;
+    clipQuadToHorizon(L, n);
+    if (n == 0)
+        return 0.0;
+
+    // the polygon is closed by L[n] = L[0], or by wrapping around for 5 vertices
+    float sum = 0.0;
+    for (int i = 0; i < n; i++)
+        sum += integrateEdge(normalize(L[i]), normalize(L[(i + 1) % 5]));
+    // only the side the corners wind counter-clockwise around emits
+    return max(0.0, sum);
+}
+
+vec3 areaLightLTC(vec3 N, vec3 V, vec3 F0)
+{
+    // texel centres hold roughness and sqrt(1 - cos theta_v) at i / (size - 1)
+    vec2 uv = vec2(surfaceRoughness, sqrt(1.0 - clamp(dot(N, V), 0.0, 1.0)));
+    uv = (uv * (ltcTableSize - 1.0) + 0.5) / ltcTableSize;
+    vec4 t1 = texture(ltc1, uv);
+    vec4 t2 = texture(ltc2, uv);
+    mat3 Minv = mat3(vec3(t1.x, 0.0, t1.y), vec3(0.0, 1.0, 0.0), vec3(t1.z, 0.0, t1.w));
+
+    float diffuseTerm = ltcEvaluate(N, V, surfacePos, mat3(1.0));
+    float specularTerm = ltcEvaluate(N, V, surfacePos, Minv);
+    // Schlick Fresnel integrated over the lobe: F0 * norm + (1 - F0) * Fresnel integral
+    vec3 specularScale = F0 * (t2.x - t2.y) + t2.y;
+    vec3 kD = (vec3(1.0) - F0) * (1.0 - surfaceMetallic);
+    return areaLightRadiance * (kD * surfaceAlbedo.rgb * diffuseTerm + specularScale * specularTerm * surfaceSpecular) / (2.0 * PI);
+}
+
+// GGX reflection of light arriving with the given radiance from a point
+vec3 pointLight(vec3 N, vec3 V, vec3 F0, vec3 position, vec3 radiance)
+{
+    vec3 L = normalize(position - surfacePos);
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, surfaceRoughness);
+    float G = GeometrySmith(N, V, L, surfaceRoughness);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - surfaceMetallic;
+
+    vec3 nominator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
+    vec3 specular_ = nominator / denominator * surfaceSpecular;
+
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * surfaceAlbedo.rgb / PI + specular_) * radiance * NdotL;
+}
+
+// the lights of this fragment's cluster, or every light when clustering is off
+vec3 clusteredLights(vec3 N, vec3 V, vec3 F0)
+{
+    int first = 0;
+    int count = clusterLightCount;
+    if (useClusters)
+    {
+        // window depth back to view depth, then the exponential slice it falls in
+        float ndcDepth = surfaceDepth * 2.0 - 1.0;
+        float n = clusterDepthRange.x, f = clusterDepthRange.y;
+        float depth = 2.0 * n * f / (f + n - ndcDepth * (f - n));
+        int slice = clamp(int(log(depth / n) * clusterSliceScale), 0, CLUSTER_SLICES - 1);
+        ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+        uvec2 run = texelFetch(clusterGrid, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+        first = int(run.x);
+        count = int(run.y);
+    }
+
+    vec3 Lo = vec3(0.0);
+    for (int i = 0; i < count; i++)
+    {
+        int light = useClusters ? int(texelFetch(clusterIndices, first + i).x) : i;
+        vec4 positionRadius = texelFetch(clusterLights, light * 2);
+        vec3 color = texelFetch(clusterLights, light * 2 + 1).rgb;
+        float distance = length(positionRadius.xyz - surfacePos);
+        // inverse square, windowed so it reaches zero at the radius the clusters were built with
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 0.0001);
+        Lo += pointLight(N, V, F0, positionRadius.xyz, color * attenuation);
+    }
+    return Lo;
+}
+
+// fraction of the light at lightPosition that reaches P, from a cached cube shadow map (see
+// include/shadow.h); eight lookups spread by softness, relative to the distance, soften the edge
+float cubeShadow(samplerCubeShadow map, vec3 lightPosition, vec2 range, float softness, vec3 P, vec3 N)
+{
+    // pushed off the surface by the filter radius, so no lookup of the filter lands behind it
+    vec3 d = P + N * (0.005 + softness * length(P - lightPosition)) - lightPosition;
+    vec3 a = abs(d);
+    // every face is a 90 degree perspective, so the stored depth follows the major axis
+    float n = range.x, f = range.y;
+    float z = max(max(max(a.x, a.y), a.z), n);
+    float depth = ((f + n) - 2.0 * f * n / z) / (f - n) * 0.5 + 0.5;
+    float lit = 0.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 offset = vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - 1.0;
+        lit += texture(map, vec4(d + offset * softness * z, depth));
+    }
+    return lit / 8.0;
+}
+
+// octahedral mapping of a unit vector to [0, 1]^2, and back
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+    return e * 0.5 + 0.5;
+}
+
+vec3 octDecode(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    return normalize(n);
+}
+
+// Writes a transparent fragment into the weighted blended targets. The weight falls off with the
+// view depth, 1 / gl_FragCoord.w, so that nearer surfaces dominate the average where several
+// overlap (equation 7 of McGuire and Bavoil 2013).
+void writeWeightedBlended(vec3 color, float alpha)
+{
+    float z = 1.0 / gl_FragCoord.w;
+    float weight = alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+    FragColor = vec4(color * alpha, alpha) * weight;
+    GAlbedo = vec4(alpha);
+}
+
 void main() {
-    vec3 N = normalize(Normal);
-    vec3 V = normalize(viewPos - FragPos);
+    vec3 N;
+    if (readGBuffer)
+    {
+        ivec2 pixel = ivec2(gl_FragCoord.xy);
+        vec4 material = texelFetch(gMaterial, pixel, 0);
+        // nothing was stored here, the pixel belongs to the background or to forward shaded objects
+        if (material.a == 0.0)
+            discard;
+        surfaceDepth = texelFetch(gDepth, pixel, 0).r;
+        vec4 position = inverseViewProjection * vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0, surfaceDepth * 2.0 - 1.0, 1.0);
+        surfacePos = position.xyz / position.w;
+        N = octDecode(texelFetch(gNormal, pixel, 0).xy);
+        surfaceAlbedo = vec4(texelFetch(gAlbedo, pixel, 0).rgb, 1.0);
+        surfaceMetallic = material.r;
+        surfaceRoughness = material.g;
+        surfaceSpecular = material.b;
+    }
+    else
+    {
+        N = normalize(Normal);
+        surfacePos = FragPos;
+        surfaceAlbedo = albedo;
+        surfaceMetallic = metallic;
+        surfaceRoughness = roughness;
+        surfaceSpecular = specular;
+        surfaceDepth = gl_FragCoord.z;
+    }
+
+    if (writeGBuffer)
+    {
+        FragColor = vec4(octEncode(N), 0.0, 1.0);
+        GAlbedo = vec4(surfaceAlbedo.rgb, 1.0);
+        GMaterial = vec4(surfaceMetallic, surfaceRoughness, surfaceSpecular, 1.0);
+        return;
+    }
+
+    vec3 V = normalize(viewPos - surfacePos);
 
     vec3 F0 = vec3(0.04);
-    F0 = mix(F0, albedo.rgb, metallic);
+    F0 = mix(F0, surfaceAlbedo.rgb, surfaceMetallic);
 
     vec3 Lo = vec3(0.0);
-    for (int i = 0; i < lightNum; i++)
+    if (useLTC)
+        Lo = areaLightLTC(N, V, F0);
+    int pointLightNum = useLTC ? 0 : lightNum;
+    for (int i = 0; i < pointLightNum; i++)
     {
-        vec3 L = normalize(lightPos[i] - FragPos);
-        vec3 H = normalize(V + L);
-        float distance = length(lightPos[i] - FragPos);
-        float attenuation = 1.0 / (distance * distance);
-        vec3 radiance = lightColor * attenuation;
-
-        float NDF = DistributionGGX(N, H, roughness);
-        float G = GeometrySmith(N, V, L, roughness);
-        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-
-        vec3 kS = F;
-        vec3 kD = vec3(1.0) - kS;
-        kD *= 1.0 - metallic;
-
-        vec3 nominator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
-        vec3 specular_ = nominator / denominator * specular;
-
-        float NdotL = max(dot(N, L), 0.0);
-        Lo += (kD * albedo.rgb / PI + specular_) * radiance * NdotL;
+        float distance = length(lightPos[i] - surfacePos);
+        Lo += pointLight(N, V, F0, lightPos[i], lightColor / (distance * distance));
     }
+    // the glow particles cast no shadows, only the area light is occluded
+    if (areaShadowEnabled)
+        Lo *= cubeShadow(areaShadowMap, areaShadowPosition, areaShadowRange, 0.03, surfacePos, N);
+    Lo += clusteredLights(N, V, F0);
 
-    vec3 ambient = vec3(0.03) * albedo.rgb;
+    vec3 ambient = vec3(0.03) * surfaceAlbedo.rgb;
     vec3 color = ambient + Lo;
     
     color = color / (color + vec3(1.0));
     color = pow(color, vec3(1.0/2.2));
-    
-    FragColor = vec4(color, albedo.a);
+
+    if (weightedBlended)
+    {
+        writeWeightedBlended(color, surfaceAlbedo.a);
+        return;
+    }
+    FragColor = vec4(color, surfaceAlbedo.a);
 }
\ No newline at end of file
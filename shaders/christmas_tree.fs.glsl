@@ -1,5 +1,6 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 Revealage;
 
 in vec2 TexCoords;
 in vec3 FragPos;
@@ -21,19 +22,106 @@ uniform vec3 viewPos;
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_opacity1;
 
+// texels below alphaCutoff are cut out of the model; with weightedBlended set only those soft
+// edges are drawn, into the weighted blended transparency targets (include/oit.h)
+uniform float alphaCutoff;
+uniform bool weightedBlended;
+
+// shadows of lightPos
+uniform bool pointShadowEnabled;
+uniform samplerCubeShadow pointShadowMap;
+uniform vec3 pointShadowPosition;
+uniform vec2 pointShadowRange;
+
+// clustered point lights, the same buffers and lookup as in arealighting.fs.glsl
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+uniform bool useClusters;
+uniform int clusterLightCount;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthRange;
+uniform float clusterSliceScale;
+
+// diffuse light from the lights of this fragment's cluster, or every light when clustering is off
+vec3 clusteredDiffuse(vec3 norm)
+{
+    int first = 0;
+    int count = clusterLightCount;
+    if (useClusters)
+    {
+        float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+        float n = clusterDepthRange.x, f = clusterDepthRange.y;
+        float depth = 2.0 * n * f / (f + n - ndcDepth * (f - n));
+        int slice = clamp(int(log(depth / n) * clusterSliceScale), 0, CLUSTER_SLICES - 1);
+        ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+        uvec2 run = texelFetch(clusterGrid, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+        first = int(run.x);
+        count = int(run.y);
+    }
+
+    vec3 light = vec3(0.0);
+    for (int i = 0; i < count; i++)
+    {
+        int index = useClusters ? int(texelFetch(clusterIndices, first + i).x) : i;
+        vec4 positionRadius = texelFetch(clusterLights, index * 2);
+        vec3 color = texelFetch(clusterLights, index * 2 + 1).rgb;
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float distance = length(toLight);
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 0.0001);
+        light += color * attenuation * max(dot(norm, toLight / distance), 0.0);
+    }
+    return light;
+}
+
+// the same lookup as cubeShadow() in arealighting.fs.glsl
+float cubeShadow(samplerCubeShadow map, vec3 lightPosition, vec2 range, float softness, vec3 P, vec3 N)
+{
+    vec3 d = P + N * (0.005 + softness * length(P - lightPosition)) - lightPosition;
+    vec3 a = abs(d);
+    float n = range.x, f = range.y;
+    float z = max(max(max(a.x, a.y), a.z), n);
+    float depth = ((f + n) - 2.0 * f * n / z) / (f - n) * 0.5 + 0.5;
+    float lit = 0.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 offset = vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - 1.0;
+        lit += texture(map, vec4(d + offset * softness * z, depth));
+    }
+    return lit / 8.0;
+}
+
+// the same weights as writeWeightedBlended() in arealighting.fs.glsl
+void writeWeightedBlended(vec3 color, float alpha)
+{
+    float z = 1.0 / gl_FragCoord.w;
+    float weight = alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+    FragColor = vec4(color * alpha, alpha) * weight;
+    Revealage = vec4(alpha);
+}
+
 void main()
 {    
    vec4 texColor = texture(texture_diffuse1, TexCoords);
    vec3 color = texColor.rgb;
 
+   float alpha = useTex ? texColor.a : 1.0;
+   if (weightedBlended ? alpha >= alphaCutoff || alpha < 0.02 : alpha < alphaCutoff)
+       discard;
+
    vec3 norm = normalize(Normal);
    vec3 lightDir = normalize(lightPos - FragPos);
-   float diff = max(dot(norm, lightDir), 0.0);
+   float shadow = pointShadowEnabled ? cubeShadow(pointShadowMap, pointShadowPosition, pointShadowRange, 0.01, FragPos, norm) : 1.0;
+   float diff = max(dot(norm, lightDir), 0.0) * shadow;
  
    vec3 viewDir = normalize(viewPos - FragPos);
    vec3 reflectDir = reflect(-lightDir, norm);  
-   float spec = pow(max(dot(viewDir, reflectDir), 0.0), Ns);
-   float tex_spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+   float spec = pow(max(dot(viewDir, reflectDir), 0.0), Ns) * shadow;
+   float tex_spec = pow(max(dot(viewDir, reflectDir), 0.0), 32) * shadow;
    
     vec3 ambient = vec3(1.0);
     vec3 diffuse = vec3(1.0); 
@@ -43,19 +131,14 @@ void main()
    if(useTex)
    {
         ambient = lightAmbient * color;
-        diffuse = diff * color;
+        diffuse = (diff + clusteredDiffuse(norm)) * color;
         specular = tex_spec * Ks.rgb;
         result = ambient + diffuse + specular;
-
-        float alpha = texture2D(texture_diffuse1, TexCoords).a;
-
-        if(alpha < 0.2f)
-            discard;
    }
    else
    {
         ambient = lightAmbient * Kd.rgb;
-        diffuse = diff * Kd.rgb;
+        diffuse = (diff + clusteredDiffuse(norm)) * Kd.rgb;
         specular = spec * Ks.rgb;
         result = ambient + diffuse + specular;
    }
@@ -71,5 +154,10 @@ void main()
        }
    }
 
-   gl_FragColor = vec4(result, 1.0);
+   if (weightedBlended)
+   {
+       writeWeightedBlended(result, alpha);
+       return;
+   }
+   FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// depth pre-pass: the position is computed exactly as in arealighting.vs and lighting.vs, so the
+// colour pass can test the depth it leaves with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * vec4(vec3(model * vec4(aPos, 1.0)), 1.0);
+}
@@ -0,0 +1,46 @@
+#version 450 core
+// one iteration of thermal erosion, the same gather as thermalErosion() in erosion.h
+out float FragHeight;
+
+uniform sampler2D heights;
+uniform float talus;
+uniform float rate;
+
+const ivec2 directions[4] = ivec2[](ivec2(1, 0), ivec2(-1, 0), ivec2(0, 1), ivec2(0, -1));
+
+bool inside(ivec2 p)
+{
+    ivec2 size = textureSize(heights, 0);
+    return all(greaterThanEqual(p, ivec2(0))) && all(lessThan(p, size));
+}
+
+// material moving from p to each of its neighbours
+vec4 outflow(ivec2 p)
+{
+    float h = texelFetch(heights, p, 0).r;
+    vec4 flow = vec4(0.0);
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 n = p + directions[i];
+        if (inside(n))
+            flow[i] = max(h - texelFetch(heights, n, 0).r - talus, 0.0);
+    }
+    float total = flow.x + flow.y + flow.z + flow.w;
+    float largest = max(max(flow.x, flow.y), max(flow.z, flow.w));
+    return total > 0.0 ? flow * (rate * largest / total) : vec4(0.0);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float h = texelFetch(heights, p, 0).r;
+    vec4 outgoing = outflow(p);
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 n = p + directions[i];
+        // direction i and i ^ 1 are opposite
+        if (inside(n))
+            h += outflow(n)[i ^ 1] - outgoing[i];
+    }
+    FragHeight = h;
+}
@@ -9,6 +9,29 @@ uniform vec3 viewPos;
 uniform vec3 lightColor;
 uniform vec3 objectColor;
 
+// ԴӰ
+uniform bool pointShadowEnabled;
+uniform samplerCubeShadow pointShadowMap;
+uniform vec3 pointShadowPosition;
+uniform vec2 pointShadowRange;
+
+//  arealighting.fs.glsl е cubeShadow() ͬ
+float cubeShadow(samplerCubeShadow map, vec3 lightPosition, vec2 range, float softness, vec3 P, vec3 N)
+{
+    vec3 d = P + N * (0.005 + softness * length(P - lightPosition)) - lightPosition;
+    vec3 a = abs(d);
+    float n = range.x, f = range.y;
+    float z = max(max(max(a.x, a.y), a.z), n);
+    float depth = ((f + n) - 2.0 * f * n / z) / (f - n) * 0.5 + 0.5;
+    float lit = 0.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 offset = vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - 1.0;
+        lit += texture(map, vec4(d + offset * softness * z, depth));
+    }
+    return lit / 8.0;
+}
+
 void main()
 {
     // 
@@ -28,6 +51,8 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;  
         
-    vec3 result = (ambient + diffuse + specular) * objectColor;
+    // Ӱֻڵ;淴
+    float shadow = pointShadowEnabled ? cubeShadow(pointShadowMap, pointShadowPosition, pointShadowRange, 0.01, FragPos, norm) : 1.0;
+    vec3 result = (ambient + shadow * (diffuse + specular)) * objectColor;
     FragColor = vec4(result, 1.0);
 } 
\ No newline at end of file
@@ -9,6 +9,9 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// the depth pre-pass (depth.vs) has to produce the same depth
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
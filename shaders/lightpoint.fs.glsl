@@ -1,6 +1,7 @@
 #version 330 core
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 Revealage;
 
 in vec3 Color;
 in float FlashDelTime;
@@ -8,6 +9,18 @@ in float FlashDelTime;
 uniform float time;
 uniform sampler2D glowTex;
 
+// weighted blended transparency, see include/oit.h
+uniform bool weightedBlended;
+
+// the same weights as writeWeightedBlended() in arealighting.fs.glsl
+void writeWeightedBlended(vec3 color, float alpha)
+{
+    float z = 1.0 / gl_FragCoord.w;
+    float weight = alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+    FragColor = vec4(color * alpha, alpha) * weight;
+    Revealage = vec4(alpha);
+}
+
 void main()
 {
     vec2 texCoord = gl_PointCoord;
@@ -19,4 +32,7 @@ void main()
 
     if (FragColor.a < 0.02)
         discard;
+
+    if (weightedBlended)
+        writeWeightedBlended(FragColor.rgb, FragColor.a);
 }
@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+// weighted blended transparency: the weighted sum of premultiplied colours and coverages, and the
+// product of one minus the coverages
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealed = texelFetch(revealage, pixel, 0).r;
+    // no transparent surface covers this pixel
+    if (revealed == 1.0)
+        discard;
+
+    vec4 sum = texelFetch(accumulation, pixel, 0);
+    // a weighted sum past the half float range keeps its direction
+    if (isinf(max(max(abs(sum.r), abs(sum.g)), abs(sum.b))))
+        sum.rgb = vec3(sum.a);
+    vec3 average = sum.rgb / max(sum.a, 1e-5);
+
+    // blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA over the opaque image
+    FragColor = vec4(average, 1.0 - revealed);
+}
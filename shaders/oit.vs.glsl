@@ -0,0 +1,8 @@
+#version 330 core
+
+// a triangle covering clip space, made from the vertex index
+void main()
+{
+    vec2 position = vec2((gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID & 2) * 2.0 - 1.0);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
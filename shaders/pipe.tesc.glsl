@@ -0,0 +1,80 @@
+#version 450 core
+layout (vertices = 1) out;
+
+// 4 cubic Bézier control points, then every sample of key section 0, 1 and 2
+uniform samplerBuffer pipeData;
+uniform int sampleCount;
+uniform float pathEnd;
+uniform int patchesAlong;
+uniform int patchesAround;
+
+uniform mat4 model;
+uniform vec3 viewPos;
+// tessellation segments per unit of edge length at unit distance from the eye
+uniform float detail;
+
+const float MAX_TESS_LEVEL = 64.0;
+
+// key section sample, linear between the stored samples and wrapping around the section
+vec3 sectionSample(int section, float s)
+{
+    float f = floor(s);
+    int j0 = int(f) % sampleCount;
+    int j1 = (j0 + 1) % sampleCount;
+    vec3 a = texelFetch(pipeData, 4 + section * sampleCount + j0).xyz;
+    vec3 b = texelFetch(pipeData, 4 + section * sampleCount + j1).xyz;
+    return mix(a, b, s - f);
+}
+
+// same sweep as PipeSweep on the CPU: the section morphs from key section 0 to 1 over the first
+// half of the path and from 1 to 2 over the second, and is moved along the cubic path
+vec3 pipePoint(float t, float s)
+{
+    bool firstHalf = t < 0.5;
+    int section = firstHalf ? 0 : 1;
+    float h = firstHalf ? t * 2.0 : t * 2.0 - 1.0;
+    vec3 from = sectionSample(section, s);
+    vec3 to = sectionSample(section + 1, s);
+    vec3 key = sectionSample(1, s);
+    vec3 middle = vec3((from.x + to.x) / 2.0, key.y, key.z);
+    vec3 point = (1.0 - h) * (1.0 - h) * from + 2.0 * h * (1.0 - h) * middle + h * h * to;
+
+    float u = 1.0 - t;
+    vec3 offset = u * u * u * texelFetch(pipeData, 0).xyz + 3.0 * t * u * u * texelFetch(pipeData, 1).xyz
+                + 3.0 * t * t * u * texelFetch(pipeData, 2).xyz + t * t * t * texelFetch(pipeData, 3).xyz;
+    return point + offset;
+}
+
+vec3 worldPoint(float t, float s)
+{
+    return vec3(model * vec4(pipePoint(t, mod(s, float(sampleCount))), 1.0));
+}
+
+// level of one edge from its length over its distance to the eye; it only depends on the edge,
+// so the two patches sharing it agree and no cracks open
+float edgeLevel(float t0, float s0, float t1, float s1)
+{
+    vec3 a = worldPoint(t0, s0);
+    vec3 m = worldPoint((t0 + t1) / 2.0, (s0 + s1) / 2.0);
+    vec3 b = worldPoint(t1, s1);
+    float length = distance(a, m) + distance(m, b);
+    return clamp(length / max(distance(m, viewPos), 0.001) * detail, 1.0, MAX_TESS_LEVEL);
+}
+
+void main()
+{
+    int along = gl_PrimitiveID / patchesAround;
+    int around = gl_PrimitiveID % patchesAround;
+    float t0 = float(along) / float(patchesAlong) * pathEnd;
+    float t1 = float(along + 1) / float(patchesAlong) * pathEnd;
+    float s0 = float(around * sampleCount) / float(patchesAround);
+    float s1 = float((around + 1) * sampleCount) / float(patchesAround);
+
+    // quad domain: u runs around the section, v along the path
+    gl_TessLevelOuter[0] = edgeLevel(t0, s0, t1, s0);
+    gl_TessLevelOuter[1] = edgeLevel(t0, s0, t0, s1);
+    gl_TessLevelOuter[2] = edgeLevel(t0, s1, t1, s1);
+    gl_TessLevelOuter[3] = edgeLevel(t1, s0, t1, s1);
+    gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+    gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+}
@@ -0,0 +1,69 @@
+#version 450 core
+layout (quads, equal_spacing, ccw) in;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// 4 cubic Bézier control points, then every sample of key section 0, 1 and 2
+uniform samplerBuffer pipeData;
+uniform int sampleCount;
+uniform float pathEnd;
+uniform int patchesAlong;
+uniform int patchesAround;
+// path parameter step of the normal's central difference, the spacing of the finest tessellation
+// along the path, set by GpuPipeSweep::Draw()
+uniform float normalStep;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// drawn again by the depth pre-pass, whose depth the colour pass tests with GL_EQUAL
+invariant gl_Position;
+
+// key section sample, linear between the stored samples and wrapping around the section
+vec3 sectionSample(int section, float s)
+{
+    float f = floor(s);
+    int j0 = int(f) % sampleCount;
+    int j1 = (j0 + 1) % sampleCount;
+    vec3 a = texelFetch(pipeData, 4 + section * sampleCount + j0).xyz;
+    vec3 b = texelFetch(pipeData, 4 + section * sampleCount + j1).xyz;
+    return mix(a, b, s - f);
+}
+
+// same sweep as PipeSweep on the CPU: the section morphs from key section 0 to 1 over the first
+// half of the path and from 1 to 2 over the second, and is moved along the cubic path
+vec3 pipePoint(float t, float s)
+{
+    bool firstHalf = t < 0.5;
+    int section = firstHalf ? 0 : 1;
+    float h = firstHalf ? t * 2.0 : t * 2.0 - 1.0;
+    vec3 from = sectionSample(section, s);
+    vec3 to = sectionSample(section + 1, s);
+    vec3 key = sectionSample(1, s);
+    vec3 middle = vec3((from.x + to.x) / 2.0, key.y, key.z);
+    vec3 point = (1.0 - h) * (1.0 - h) * from + 2.0 * h * (1.0 - h) * middle + h * h * to;
+
+    float u = 1.0 - t;
+    vec3 offset = u * u * u * texelFetch(pipeData, 0).xyz + 3.0 * t * u * u * texelFetch(pipeData, 1).xyz
+                + 3.0 * t * t * u * texelFetch(pipeData, 2).xyz + t * t * t * texelFetch(pipeData, 3).xyz;
+    return point + offset;
+}
+
+void main()
+{
+    int along = gl_PrimitiveID / patchesAround;
+    int around = gl_PrimitiveID % patchesAround;
+    float t = (float(along) + gl_TessCoord.y) / float(patchesAlong) * pathEnd;
+    float s = mod((float(around) + gl_TessCoord.x) * float(sampleCount) / float(patchesAround), float(sampleCount));
+    vec3 pos = pipePoint(t, s);
+
+    // normal from central differences along the path and around the section, as on the CPU
+    vec3 alongPath = pipePoint(t + normalStep, s) - pipePoint(t - normalStep, s);
+    vec3 aroundSection = pipePoint(t, mod(s + 0.5, float(sampleCount))) - pipePoint(t, mod(s - 0.5 + float(sampleCount), float(sampleCount)));
+
+    FragPos = vec3(model * vec4(pos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normalize(cross(alongPath, aroundSection));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
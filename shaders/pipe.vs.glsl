@@ -0,0 +1,7 @@
+#version 450 core
+
+// the GPU pipe has no vertex data, every patch is one attribute-less vertex and the
+// tessellation shaders work out the surface from gl_PrimitiveID
+void main()
+{
+}
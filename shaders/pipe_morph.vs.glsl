@@ -0,0 +1,76 @@
+#version 450 core
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// 4 cubic Bézier control points, then the key sections: frame-major, then key, then sample
+uniform samplerBuffer pipeData;
+uniform int keyCount;
+uniform int frameCount;
+uniform int sampleCount;
+uniform int ringCount;
+// keyframe position of the animation, frames loop
+uniform float frame;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// drawn again by the depth pre-pass, whose depth the colour pass tests with GL_EQUAL
+invariant gl_Position;
+
+// uniform Catmull-Rom spline through p1 and p2
+vec3 catmullRom(vec3 p0, vec3 p1, vec3 p2, vec3 p3, float u)
+{
+    return 0.5 * (2.0 * p1 + (p2 - p0) * u + (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3) * u * u
+                  + (3.0 * p1 - p0 - 3.0 * p2 + p3) * u * u * u);
+}
+
+vec3 keySample(int f, int key, int sampleIndex)
+{
+    return texelFetch(pipeData, 4 + (f * keyCount + key) * sampleCount + sampleIndex).xyz;
+}
+
+// one key section sampleIndex at the current time, the keyframes wrap around
+vec3 animatedSample(int key, int sampleIndex)
+{
+    float f = floor(frame);
+    int f1 = int(f) % frameCount;
+    int f0 = (f1 + frameCount - 1) % frameCount;
+    int f2 = (f1 + 1) % frameCount;
+    int f3 = (f1 + 2) % frameCount;
+    return catmullRom(keySample(f0, key, sampleIndex), keySample(f1, key, sampleIndex), keySample(f2, key, sampleIndex), keySample(f3, key, sampleIndex), frame - f);
+}
+
+// the key sections are spaced evenly along the path, the spline is clamped at both ends
+vec3 pipePoint(float t, int sampleIndex)
+{
+    sampleIndex = (sampleIndex + sampleCount) % sampleCount;
+    float position = clamp(t, 0.0, 1.0) * float(keyCount - 1);
+    int k = min(int(position), keyCount - 2);
+    vec3 section = catmullRom(animatedSample(max(k - 1, 0), sampleIndex), animatedSample(k, sampleIndex),
+                              animatedSample(k + 1, sampleIndex), animatedSample(min(k + 2, keyCount - 1), sampleIndex), position - float(k));
+
+    float u = 1.0 - t;
+    vec3 offset = u * u * u * texelFetch(pipeData, 0).xyz + 3.0 * t * u * u * texelFetch(pipeData, 1).xyz
+                + 3.0 * t * t * u * texelFetch(pipeData, 2).xyz + t * t * t * texelFetch(pipeData, 3).xyz;
+    return section + offset;
+}
+
+void main()
+{
+    // no vertex data, the vertex id is the ring-major grid position
+    int ring = gl_VertexID / sampleCount;
+    int sampleIndex = gl_VertexID % sampleCount;
+    float dt = 1.0 / float(ringCount - 1);
+    float t = float(ring) * dt;
+    vec3 pos = pipePoint(t, sampleIndex);
+
+    // central differences along the path and around the section, one-sided at the ends of the pipe
+    vec3 along = pipePoint(min(t + dt, 1.0), sampleIndex) - pipePoint(max(t - dt, 0.0), sampleIndex);
+    vec3 around = pipePoint(t, sampleIndex + 1) - pipePoint(t, sampleIndex - 1);
+
+    FragPos = vec3(model * vec4(pos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normalize(cross(along, around));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
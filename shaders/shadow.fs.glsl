@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth-only pass into a shadow map, nothing but the depth is written
+void main()
+{
+}
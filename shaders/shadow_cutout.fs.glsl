@@ -0,0 +1,14 @@
+#version 330 core
+in vec2 TexCoords;
+
+uniform bool useTex;
+uniform sampler2D texture_diffuse1;
+// the same cutoff as the colour pass, so the leaves cut out there let the light through here
+uniform float alphaCutoff;
+
+// depth-only pass for alpha-tested models: only the texels the colour pass keeps write depth
+void main()
+{
+    if (useTex && texture(texture_diffuse1, TexCoords).a < alphaCutoff)
+        discard;
+}
@@ -1,7 +1,54 @@
 #version 450 core
 out vec4 FragColor;
+
+// barycentric coordinates emitted by the geometry shader
+in vec3 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+
 uniform vec3 color;
+uniform vec3 wireColor;
+uniform float wireWidth; // edge width in pixels
+uniform vec3 lightPos;
+
+// shadows of lightPos
+uniform bool pointShadowEnabled;
+uniform samplerCubeShadow pointShadowMap;
+uniform vec3 pointShadowPosition;
+uniform vec2 pointShadowRange;
+
+// the same lookup as cubeShadow() in arealighting.fs.glsl
+float cubeShadow(samplerCubeShadow map, vec3 lightPosition, vec2 range, float softness, vec3 P, vec3 N)
+{
+    vec3 d = P + N * (0.005 + softness * length(P - lightPosition)) - lightPosition;
+    vec3 a = abs(d);
+    float n = range.x, f = range.y;
+    float z = max(max(max(a.x, a.y), a.z), n);
+    float depth = ((f + n) - 2.0 * f * n / z) / (f - n) * 0.5 + 0.5;
+    float lit = 0.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 offset = vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - 1.0;
+        lit += texture(map, vec4(d + offset * softness * z, depth));
+    }
+    return lit / 8.0;
+}
+
 void main()
 {
-    FragColor = vec4(color,1.0);   
-}
\ No newline at end of file
+    // fwidth turns the barycentric distance to each edge into pixels, so edges keep
+    // the same width on screen and fade out over one pixel for anti-aliasing
+    vec3 pixels = TexCoords / fwidth(TexCoords);
+    float edgeDistance = min(min(pixels.x, pixels.y), pixels.z);
+    float edge = 1.0 - smoothstep(wireWidth - 0.5, wireWidth + 0.5, edgeDistance);
+
+    // the heightmap normals shade the surface, so its relief shows between the grid lines
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPos - FragPos);
+    float diffuse = max(dot(norm, lightDir), 0.0);
+    if (pointShadowEnabled)
+        diffuse *= cubeShadow(pointShadowMap, pointShadowPosition, pointShadowRange, 0.01, FragPos, norm);
+    float light = 0.3 + 0.7 * diffuse;
+
+    FragColor = vec4(mix(color, wireColor, edge) * light, 1.0);
+}
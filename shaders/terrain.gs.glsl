@@ -1,23 +1,32 @@
 #version 450 core
 layout(triangles) in;
 layout(triangle_strip, max_vertices = 3) out;
-in VS_OUT {
-    vec3 texCoords;
+in TE_OUT {
+    vec3 FragPos;
+    vec3 Normal;
 } gs_in[];
 out vec3 TexCoords; 
+out vec3 FragPos;
+out vec3 Normal;
 	 
 void main()
 {
     gl_Position = gl_in[0].gl_Position ; 
     TexCoords=vec3(1,0,0);
+    FragPos = gs_in[0].FragPos;
+    Normal = gs_in[0].Normal;
     EmitVertex();
 
     gl_Position = gl_in[1].gl_Position ; 
     TexCoords=vec3(0,1,0);
+    FragPos = gs_in[1].FragPos;
+    Normal = gs_in[1].Normal;
     EmitVertex();
 
     gl_Position = gl_in[2].gl_Position ; 
     TexCoords=vec3(0,0,1);
+    FragPos = gs_in[2].FragPos;
+    Normal = gs_in[2].Normal;
     EmitVertex();
 
     EndPrimitive();
@@ -1,18 +1,98 @@
 
 #version 450 core
 layout (vertices = 3) out;
+
+in vec2 Grid[];
+out vec2 tcGrid[];
+
 uniform int inner;
 uniform int outer;
+
+// screen-space adaptive tessellation
+uniform bool adaptive;
+uniform vec2 viewportSize;
+uniform float pixelsPerEdge;
+
+const float MAX_TESS_LEVEL = 64.0;
+
+vec2 toScreen(vec4 clipPos)
+{
+    return (clipPos.xy / clipPos.w * 0.5 + 0.5) * viewportSize;
+}
+
+// level of one edge, only depends on its two end points so neighbouring patches agree on it
+float edgeLevel(vec4 a, vec4 b)
+{
+    // an edge crossing the eye plane can't be projected, keep it at full detail
+    if (a.w <= 0.0 || b.w <= 0.0)
+        return MAX_TESS_LEVEL;
+    float pixels = distance(toScreen(a), toScreen(b));
+    return clamp(pixels / pixelsPerEdge, 1.0, MAX_TESS_LEVEL);
+}
+
+// the patch is invisible when all three corners are outside the same clip plane
+bool outsideFrustum(vec4 a, vec4 b, vec4 c)
+{
+    return (a.x >  a.w && b.x >  b.w && c.x >  c.w) ||
+           (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+           (a.y >  a.w && b.y >  b.w && c.y >  c.w) ||
+           (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+           (a.z >  a.w && b.z >  b.w && c.z >  c.w) ||
+           (a.z < -a.w && b.z < -b.w && c.z < -c.w);
+}
+
+// terrain triangles are wound counter-clockwise when seen from above
+bool facingAway(vec4 a, vec4 b, vec4 c)
+{
+    if (a.w <= 0.0 || b.w <= 0.0 || c.w <= 0.0)
+        return false;
+    vec2 p0 = a.xy / a.w;
+    vec2 p1 = b.xy / b.w;
+    vec2 p2 = c.xy / c.w;
+    vec2 e0 = p1 - p0;
+    vec2 e1 = p2 - p0;
+    return e0.x * e1.y - e0.y * e1.x < 0.0;
+}
+
 void main(){
-    //inner
-    gl_TessLevelInner[0] = inner;
-
-    // outer
-    gl_TessLevelOuter[0] = outer;
-    gl_TessLevelOuter[1] = outer;
-    gl_TessLevelOuter[2] = outer;
-    
+    if (gl_InvocationID == 0)
+    {
+        if (adaptive)
+        {
+            vec4 p0 = gl_in[0].gl_Position;
+            vec4 p1 = gl_in[1].gl_Position;
+            vec4 p2 = gl_in[2].gl_Position;
+
+            if (outsideFrustum(p0, p1, p2) || facingAway(p0, p1, p2))
+            {
+                // outer level 0 discards the whole patch
+                gl_TessLevelOuter[0] = 0.0;
+                gl_TessLevelOuter[1] = 0.0;
+                gl_TessLevelOuter[2] = 0.0;
+                gl_TessLevelInner[0] = 0.0;
+            }
+            else
+            {
+                // outer level i belongs to the edge opposite to vertex i
+                gl_TessLevelOuter[0] = edgeLevel(p1, p2);
+                gl_TessLevelOuter[1] = edgeLevel(p2, p0);
+                gl_TessLevelOuter[2] = edgeLevel(p0, p1);
+                gl_TessLevelInner[0] = max(gl_TessLevelOuter[0], max(gl_TessLevelOuter[1], gl_TessLevelOuter[2]));
+            }
+        }
+        else
+        {
+            //inner
+            gl_TessLevelInner[0] = inner;
+
+            // outer
+            gl_TessLevelOuter[0] = outer;
+            gl_TessLevelOuter[1] = outer;
+            gl_TessLevelOuter[2] = outer;
+        }
+    }
+
     gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
-    //TextureCoord[gl_InvocationID] = TexCoord[gl_InvocationID];
- 
+    tcGrid[gl_InvocationID] = Grid[gl_InvocationID];
+
 }
@@ -1,10 +1,44 @@
 #version 450 core
 layout(triangles , equal_spacing,ccw) in;
 
+in vec2 tcGrid[];
+
+out TE_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+} te_out;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform sampler2D heightMap;
+
+// grid coordinates run through the texel centres, so the grid corners land on the corner samples
+float height(vec2 grid)
+{
+    vec2 size = vec2(textureSize(heightMap, 0));
+    return texture(heightMap, (grid * (size - 1.0) + 0.5) / size).r;
+}
+
+// flat grid mapped onto a disk and displaced by the heightmap
+vec3 surface(vec2 grid)
+{
+    vec2 r = grid * 2.0 - 1.0;
+    float x = r.x * sqrt(1.0 - r.y * r.y / 2.0) * 0.5;
+    float z = r.y * sqrt(1.0 - r.x * r.x / 2.0) * 0.5;
+    return vec3(x, height(grid), z);
+}
+
 void main(){
- 
-    vec4 upos= gl_TessCoord.x * gl_in[0].gl_Position;
-    vec4 vpos= gl_TessCoord.y * gl_in[1].gl_Position;
-    vec4 wpos= gl_TessCoord.z * gl_in[2].gl_Position;
-    gl_Position = upos + vpos + wpos;
+    vec2 grid = gl_TessCoord.x * tcGrid[0] + gl_TessCoord.y * tcGrid[1] + gl_TessCoord.z * tcGrid[2];
+    vec3 pos = surface(grid);
+
+    // normal from central differences one heightmap texel apart
+    vec2 texel = 1.0 / vec2(textureSize(heightMap, 0) - 1);
+    vec3 dx = surface(grid + vec2(texel.x, 0.0)) - surface(grid - vec2(texel.x, 0.0));
+    vec3 dz = surface(grid + vec2(0.0, texel.y)) - surface(grid - vec2(0.0, texel.y));
+
+    te_out.FragPos = vec3(model * vec4(pos, 1.0));
+    te_out.Normal = mat3(transpose(inverse(model))) * cross(dz, dx);
+    gl_Position = projection * view * vec4(te_out.FragPos, 1.0);
 }
@@ -1,18 +1,33 @@
 #version 450 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+// position on the flat terrain grid in [0, 1], the height comes from the heightmap
+layout (location = 0) in vec2 aGrid;
 
-out vec3 FragPos;
-out vec3 Normal;
+out vec2 Grid;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform sampler2D heightMap;
+
+// grid coordinates run through the texel centres, so the grid corners land on the corner samples
+float height(vec2 grid)
+{
+    vec2 size = vec2(textureSize(heightMap, 0));
+    return texture(heightMap, (grid * (size - 1.0) + 0.5) / size).r;
+}
+
+// same mapping of the grid onto a disk as in terrain.tese.glsl
+vec3 surface(vec2 grid)
+{
+    vec2 r = grid * 2.0 - 1.0;
+    float x = r.x * sqrt(1.0 - r.y * r.y / 2.0) * 0.5;
+    float z = r.y * sqrt(1.0 - r.x * r.x / 2.0) * 0.5;
+    return vec3(x, height(grid), z);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
-    
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    Grid = aGrid;
+    // the control shader picks tessellation levels and culls patches from the displaced corners
+    gl_Position = projection * view * model * vec4(surface(aGrid), 1.0);
 }
@@ -0,0 +1,20 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in float Height;
+
+uniform vec3 lightDir;  // direction the sunlight travels
+uniform float heightScale;
+
+void main()
+{
+    // grass in the valleys, rock and snow higher up
+    float h = Height / heightScale;
+    vec3 color = mix(vec3(0.25, 0.45, 0.18), vec3(0.45, 0.40, 0.35), smoothstep(0.35, 0.6, h));
+    color = mix(color, vec3(0.95), smoothstep(0.7, 0.8, h));
+
+    float diffuse = max(dot(normalize(Normal), -normalize(lightDir)), 0.0);
+    FragColor = vec4(color * (0.3 + 0.7 * diffuse), 1.0);
+}
@@ -0,0 +1,36 @@
+#version 450 core
+// position inside the tile in [0, 1], the height comes from the tile's layer of the pool
+layout (location = 0) in vec2 aGrid;
+
+out vec3 FragPos;
+out vec3 Normal;
+out float Height;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform sampler2DArray heightTiles;
+uniform int layer;
+uniform vec3 tileOrigin;
+uniform float tileExtent;
+uniform float heightScale;
+
+// tiles repeat their border samples, running the grid through the texel centres makes neighbours meet exactly
+float height(vec2 grid)
+{
+    vec2 size = vec2(textureSize(heightTiles, 0).xy);
+    return texture(heightTiles, vec3((grid * (size - 1.0) + 0.5) / size, layer)).r * heightScale;
+}
+
+void main()
+{
+    Height = height(aGrid);
+    FragPos = tileOrigin + vec3(aGrid.x * tileExtent, Height, aGrid.y * tileExtent);
+
+    // normal from central differences one texel apart
+    float texel = 1.0 / float(textureSize(heightTiles, 0).x - 1);
+    float dx = height(aGrid + vec2(texel, 0.0)) - height(aGrid - vec2(texel, 0.0));
+    float dz = height(aGrid + vec2(0.0, texel)) - height(aGrid - vec2(0.0, texel));
+    Normal = normalize(vec3(-dx, 2.0 * texel * tileExtent, -dz));
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -12,37 +12,46 @@
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
-
+#include "query.h"
+#include "debug.h"
+#include "terrain.h"
+#include "terrain_stream.h"
+#include "erosion.h"
+#include "pipe.h"
+#include "arealight.h"
+#include "clustered.h"
+#include "gbuffer.h"
+#include "shadow.h"
+#include "opaque.h"
+#include "depthsort.h"
+#include "oit.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "headless.h"
+#include "replay.h"
+#include "particles.h"
+#include "simulation.h"
+#include "drawlist.h"
+#include "pacing.h"
+
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-// ѩ
-struct SnowParticle {
-    glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec3 color;  // ѩɫڰɫǳɫ֮
-};
-
-// 
-struct LightParticle {
-    glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec3 color;
-    float flashDelTime;
-};
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void window_pos_callback(GLFWwindow* window, int xpos, int ypos);
+void monitor_callback(GLFWmonitor* monitor, int event);
+GLFWmonitor* windowMonitor(GLFWwindow* window);
 void processInput(GLFWwindow* window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-void initSnowParticle(SnowParticle& particle);
-void initLightParticle(LightParticle& particle);
-glm::vec3 bezier2(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, float t);
-glm::vec3 bezier3(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, float t);
+bool keyPressed(GLFWwindow* window, int key);
 
 // 
 const unsigned int SCR_WIDTH = 800;
@@ -54,9 +63,15 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// ʱ
+// ʱã֡ʱ˫ȣʱк֮֡ʱȻ׼ȷ
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+double lastFrame = 0.0;
+
+// ֡ʿ
+int swapInterval = 1; // 0 رմֱͬ1 ÿĻˢʾһ֡
+double frameRateCap = 0.0; // ֡ޣ0 ΪƣʱȾѭ֮֡˯ߣռһ
+bool idleWhenUnfocused = false; // ʧȥʱǷҲ֡ʣĬֻСʱŽһ̨ʾϿɼĴճȾ
+bool refreshRateStale = true; // ƶ롢Ͽʾ²ѯʾˢ
 
 // 
 glm::vec3 lightPos(0.0f, 0.75f, 1.65f);
@@ -80,7 +95,8 @@ bool windmillAppear = false; // 
 bool windmillColorful = false; // 糵Ƿɫ
 bool windmillRotate = false; // 糵Ƿת
 float windmillSpeed = 90.0f; // 糵תٶ
-float windmillAngle = 0.0f; // 糵ǰǶ
+float windmillAngle = 0.0f; // 糵ǰǶȣģĿղֵõ
+float windmillNudge = 0.0f; // ֡÷ת糵ĽǶȣģһӦ
 bool snowAppear = false;     // ǷѩЧ
 unsigned int snowParticleCount = 400; // ѩ
 bool isLightOn = false; // ʥǷ
@@ -98,44 +114,146 @@ float pipeColorB = 0.09;
 float pipeColorA = 1.0;
 int pipeMaterialSelect = 1;
 
-int main()
+// ϸ
+bool terrainAdaptive = true; // ǷĻռ߳Ӧϸ
+float terrainPixelsPerEdge = 8.0f; // ϸֺÿߵĿس
+
+// ʽ
+bool terrainStreamDisplay = false; // ǷʾӴ̷ֿʽص
+
+bool terrainErosionRequested = false; // Ƿһ֡ʴ
+
+bool areaLightLTC = true; // ǷԱ任(LTC)ԴõԴн
+
+// ۴ǰ
+bool clusteredLighting = true; // ǷֻƬڴڵĹԴÿƬαйԴ
+float particleLightRadius = 0.35f; // ΪԴ뾶
+float particleLightIntensity = 0.002f; // ΪԴǿ
+
+bool deferredShading = false; // ͹ܵǷд G-bufferһȫռɫ
+
+bool shadowsEnabled = true; // ԴԴǷͶӰ
+
+bool depthPrePass = false; // ͸Ƿֻдȣɫʱÿֻı
+bool transparentSorting = true; // ͸ĹӺ͹ܵǷӺǰ
+bool weightedBlendedOIT = false; // ͸ǷüȨϵ˳޹͸ȣ
+
+// ܵ༭
+bool pipeEditing = false; // Ƿڱ༭ܵ
+int pipeEditHandle = 0; // ǰ༭ĿƱ0-3 Ϊ߿Ƶ㣬4-6 Ϊؼ
+glm::vec3 pipeEditMove(0.0f); // ֡Ʊƶ
+
+// ܵӦ
+bool pipeAdaptive = false; // ǷӦѡȡͽ
+float pipeTolerance = 0.0005f; // Ӧռ
+bool pipeResampleRequested = false; // Ƿһ֡²ܵ
+
+bool pipeOnGpu = false; // Ƿϸɫ GPU ɹܵ
+bool pipeMorphing = false; // ǷʾڶɫʱεĹܵ
+
+bool statsRequested = false; // Ƿһ֡ͳϢ
+bool profileExportRequested = false; // Ƿڱܷ֡¼д Chrome trace ļ
+
+// ¼ط
+InputRecorder inputRecorder; // --recordѰ͹¼ͬдļ
+InputReplay inputReplay; // ̶ʱ䲽¼Ƶ¼ͻػص
+bool replayingInput = false; // Ƿڻط¼Ƶ룬ʱԴڵʵ
+
+int main(int argc, char* argv[])
 {
-    // ʼglfw
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // glfwSession оֲ֮ǰmain κһʱ OpenGL ľֲ
+    // ѯ֡塭ȻЧֹ֮ glfwglfw ûгʼʱֹκ
+    struct GlfwSession { ~GlfwSession() { glfwTerminate(); } } glfwSession;
+
+    // --bench-headless [ű] []ڣаűط·ͳأԹ̶ʱ䲽Ⱦ
+    // д֡ʱٷλƵһ֡У͵ JSON ˳
+    bool headless = argc > 1 && std::string(argv[1]) == "--bench-headless";
+    std::string benchmarkScriptPath = headless && argc > 2 ? argv[2] : "benchmarks/flythrough.txt";
+    std::string benchmarkReportPath = headless && argc > 3 ? argv[3] : "benchmark.json";
+    BenchmarkScript benchmarkScript;
+    if (headless && !benchmarkScript.Load(benchmarkScriptPath))
+        return -1;
+
+    // --record <ļ>¼Ƶļ--replay <ļ> [ʱ䲽]̶ʱ䲽ط¼Ƶ룬
+    // ܷͳƲ˳׼ԽűҲ input ָط¼Ƶ
+    std::string inputRecordPath = argc > 2 && std::string(argv[1]) == "--record" ? argv[2] : "";
+    std::string inputReplayPath = argc > 2 && std::string(argv[1]) == "--replay" ? argv[2] : headless ? benchmarkScript.Input : "";
+    float replayTimestep = headless ? benchmarkScript.Timestep : 1.0f / 60.0f;
+    if (!headless && argc > 3 && std::string(argv[1]) == "--replay") {
+        // ʱ䲽طŲǰֱĩβ
+        char* end = nullptr;
+        replayTimestep = std::strtof(argv[3], &end);
+        if (end == argv[3] || *end != '\0' || !std::isfinite(replayTimestep) || replayTimestep <= 0.0f) {
+            std::cout << "ERROR::INPUT_REPLAY::BAD_TIMESTEP: " << argv[3] << std::endl;
+            return -1;
+        }
+    }
+    replayingInput = !inputReplayPath.empty();
+    if (replayingInput && !inputReplay.Load(inputReplayPath))
+        return -1;
+
+    GLFWwindow* window = NULL;
+    GLADloadproc loadProc = (GLADloadproc)glfwGetProcAddress;
+#ifdef __linux__
+    std::unique_ptr<HeadlessContext> headlessContext;
+#endif
+    if (headless) {
+#ifdef __linux__
+        // EGL ģûʾ GPU ʱ Mesa llvmpipe Ⱦ
+        headlessContext = std::make_unique<HeadlessContext>(SCR_WIDTH, SCR_HEIGHT);
+        if (!headlessContext->IsValid())
+            return -1;
+        loadProc = (GLADloadproc)HeadlessContext::GetProcAddress;
+#else
+        std::cout << "--bench-headless needs an EGL offscreen context, only available on Linux" << std::endl;
+        return -1;
+#endif
+    } else {
+        // ʼglfw
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // glfw
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(swapInterval);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        //  ImGui ֮ǰãImGui װԼʾصʱŵ
+        glfwSetWindowPosCallback(window, window_pos_callback);
+        glfwSetMonitorCallback(monitor_callback);
+
+        //  GLFW ǵ
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-
-    //  GLFW ǵ
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad OpenGL ָ
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader(loadProc))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+#ifdef _DEBUG
+    installDrawChecks();
+#endif
+    if (headless)
+        installDrawCounters();
 
     // ȫ OpenGL ״̬
     // -----------------------------
@@ -144,6 +262,13 @@ int main()
     glEnable(GL_PROGRAM_POINT_SIZE);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX); // ͵ֵ(0xFFFF/0xFFFFFFFF)δ
+
+    // --bench-erosionֻеʴܲԺ˳
+    if (argc > 1 && std::string(argv[1]) == "--bench-erosion") {
+        benchmarkErosion();
+        return 0;
+    }
 
     // shader
     // ------------------------------------
@@ -151,6 +276,7 @@ int main()
     Shader lightCubeShader("shaders/lightcube.vs.glsl", "shaders/lightcube.fs.glsl");
     Shader christmasTreeShader("shaders/christmas_tree.vs.glsl", "shaders/christmas_tree.fs.glsl");
     Shader terrainShader("shaders/terrain.vert.glsl", "shaders/terrain.frag.glsl", "shaders/terrain.tesc.glsl", "shaders/terrain.tese.glsl", "shaders/terrain.gs.glsl");
+    Shader terrainStreamShader("shaders/terrainstream.vs.glsl", "shaders/terrainstream.fs.glsl");
     Shader snowShader("shaders/snow.vs.glsl", "shaders/snow.fs.glsl");
     Shader lightPointShader("shaders/lightpoint.vs.glsl", "shaders/lightpoint.fs.glsl");
     Shader areaLightCubeShader("shaders/arealightcube.vs.glsl", "shaders/arealightcube.fs.glsl");
@@ -163,11 +289,16 @@ int main()
     ImGui::CreateContext();
 
     // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
+    if (window) {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330");
+    }
     int inner = 1;
     int outer = 1;
 
+    // ͳƵϸֺʵɵͼԪ
+    AsyncQuery terrainPrimitivesQuery(GL_PRIMITIVES_GENERATED);
+
     // ͳһõϢ(ÿһǰΪ꣬Ϊ)
     // ------------------------------------------------------------------
     float vertices[] = {
@@ -419,33 +550,40 @@ int main()
     }
 
     std::vector<float> terrainVertices;
-    std::vector<unsigned int> terrainIndices;
+    std::vector<unsigned short> terrainIndices; // ζ 65535ʹ16λ
     const unsigned int terrainWidth = 64;
+    static_assert(terrainWidth * terrainWidth < 0xFFFF, "terrain indices must fit in 16 bits");
 
-    // ԭʼζϢӳԲ
-    for (int z = 0; z < terrainWidth; ++z) {
-        for (int x = 0; x < terrainWidth; ++x) {
-            float x_r = static_cast<float>(x) / terrainWidth * 2 - 1.0f;
-            float z_r = static_cast<float>(z) / terrainWidth * 2 - 1.0f;
+    // ɵθ߶ͼֱ޹أϸϸֺɫвõ
+    const unsigned int terrainHeightmapSize = 256;
+    Heightmap terrainHeightmap(terrainHeightmapSize);
+    terrainHeightmap.GeneratePerlin(6.4f, 3);
 
-            float x_c = x_r * glm::sqrt(1 - z_r * z_r / 2.0f) * 0.5f;
-            float z_c = z_r * glm::sqrt(1 - x_r * x_r / 2.0f) * 0.5f;
+    // ƽ˲ͼ
+    terrainHeightmap.Smooth(1);
 
-            float y = glm::perlin(glm::vec2(x * 0.1f, z * 0.1f)) / 2 + 0.5f;
+    // ʴʴƽ£ˮʴˮγˢ
+    ThermalErosionSettings terrainThermal;
+    HydraulicErosionSettings terrainHydraulic;
+    thermalErosion(terrainHeightmap, terrainThermal, 20);
+    hydraulicErosion(terrainHeightmap, terrainHydraulic, 4);
+    terrainHeightmap.Upload();
 
-            terrainVertices.push_back(x_c);
-            terrainVertices.push_back(y);
-            terrainVertices.push_back(z_c);
+    // ƽ̹Ĳֻ꣬ӳԲ͸߶λƶɫ
+    for (int z = 0; z < terrainWidth; ++z) {
+        for (int x = 0; x < terrainWidth; ++x) {
+            terrainVertices.push_back(static_cast<float>(x) / (terrainWidth - 1));
+            terrainVertices.push_back(static_cast<float>(z) / (terrainWidth - 1));
         }
     }
     
     // ɵ
     for (int z = 0; z < terrainWidth - 1; ++z) {
         for (int x = 0; x < terrainWidth - 1; ++x) {
-            unsigned int topLeft = z * terrainWidth + x;
-            unsigned int topRight = topLeft + 1;
-            unsigned int bottomLeft = topLeft + terrainWidth;
-            unsigned int bottomRight = bottomLeft + 1;
+            unsigned short topLeft = z * terrainWidth + x;
+            unsigned short topRight = topLeft + 1;
+            unsigned short bottomLeft = topLeft + terrainWidth;
+            unsigned short bottomRight = bottomLeft + 1;
 
             terrainIndices.push_back(topLeft);
             terrainIndices.push_back(bottomLeft);
@@ -457,36 +595,6 @@ int main()
         }
     }
 
-    // ƽ˲ͼ
-    {
-        std::vector<float> tmpVertices(terrainVertices.size() / 3, 0.0f);
-
-        for (int z = 0; z < terrainWidth; ++z) {
-            for (int x = 0; x < terrainWidth; ++x) {
-                float sum = 0.0f;
-                int count = 0;
-
-                for (int dz = -1; dz <= 1; ++dz) {
-                    for (int dx = -1; dx <= 1; ++dx) {
-                        int nx = x + dx;
-                        int nz = z + dz;
-
-                        if (nx >= 0 && nx < terrainWidth && nz >= 0 && nz < terrainWidth) {
-                            int neighborIndex = nz * terrainWidth + nx;
-                            sum += terrainVertices[neighborIndex * 3 + 1];
-                            ++count;
-                        }
-                    }
-                }
-
-                tmpVertices[z * terrainWidth + x] = sum / count;
-            }
-        }
-
-        for (size_t i = 0; i < tmpVertices.size(); ++i)
-            terrainVertices[i * 3 + 1] = tmpVertices[i];
-    }
-
     // ζϢ
     unsigned int VBO10, terrainVAO, terrainEBO;
     {
@@ -499,9 +607,9 @@ int main()
         glBufferData(GL_ARRAY_BUFFER, terrainVertices.size() * sizeof(float), terrainVertices.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrainIndices.size() * sizeof(unsigned int), terrainIndices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrainIndices.size() * sizeof(unsigned short), terrainIndices.data(), GL_STATIC_DRAW);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(0 * sizeof(float)));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)(0 * sizeof(float)));
         glEnableVertexAttribArray(0);
 
         glBindVertexArray(0);
@@ -511,91 +619,52 @@ int main()
 
     
     std::vector<float> platformVertices;
-    std::vector<unsigned int> platformIndices;
-
-    // ƽ̨涥
-    for (int x = 0, z = 0; x < terrainWidth; x++) {
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(-0.5f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 1]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-    }
-
-    for (int x = terrainWidth - 1, z = 0; z < terrainWidth; z++) {
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(-0.5f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 1]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+    std::vector<unsigned short> platformIndices;
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-    }
+    // ƽ̨涥㣬صαԵ߶CPU϶Ը߶ͼʴκ
+    auto addPlatformColumn = [&](int x, int z) {
+        glm::vec3 top = terrainPosition(terrainHeightmap, glm::vec2(x, z) / float(terrainWidth - 1));
 
-    for (int x = terrainWidth - 1, z = terrainWidth - 1; x > 0; x--) {
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
+        platformVertices.push_back(top.x);
         platformVertices.push_back(-0.5f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+        platformVertices.push_back(top.z);
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
+        platformVertices.push_back(top.x);
         platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+        platformVertices.push_back(top.z);
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 1]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+        platformVertices.push_back(top.x);
+        platformVertices.push_back(top.y);
+        platformVertices.push_back(top.z);
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
+        platformVertices.push_back(top.x);
         platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-    }
+        platformVertices.push_back(top.z);
+    };
 
-    for (int x = 0, z = terrainWidth - 1; z > 0; z--) {
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(-0.5f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+    auto generatePlatformVertices = [&]() {
+        platformVertices.clear();
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+        for (int x = 0, z = 0; x < terrainWidth; x++)
+            addPlatformColumn(x, z);
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 1]);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
+        for (int x = terrainWidth - 1, z = 0; z < terrainWidth; z++)
+            addPlatformColumn(x, z);
 
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3]);
-        platformVertices.push_back(0.0f);
-        platformVertices.push_back(terrainVertices[(z * terrainWidth + x) * 3 + 2]);
-    }
+        for (int x = terrainWidth - 1, z = terrainWidth - 1; x > 0; x--)
+            addPlatformColumn(x, z);
 
-    // ƽ̨
-    for (int i = 0; i < platformVertices.size() / 12; ++i) {
-        platformIndices.push_back(i * 2);
-        platformIndices.push_back((i * 2 + 1) % (platformVertices.size() / 6));
-        platformIndices.push_back((i * 2 + 3) % (platformVertices.size() / 6));
+        for (int x = 0, z = terrainWidth - 1; z > 0; z--)
+            addPlatformColumn(x, z);
+    };
+    generatePlatformVertices();
 
-        platformIndices.push_back(i * 2);
-        platformIndices.push_back((i * 2 + 3) % (platformVertices.size() / 6));
-        platformIndices.push_back((i * 2 + 2) % (platformVertices.size() / 6));
+    // ƽ̨һβӵδ
+    for (int i = 0; i < platformVertices.size() / 6; ++i) {
+        platformIndices.push_back(i);
     }
+    platformIndices.push_back(0);
+    platformIndices.push_back(1);
     
     // ƽ̨Ϣ
     unsigned int VBO11, platformVAO, platformEBO;
@@ -609,7 +678,7 @@ int main()
         glBufferData(GL_ARRAY_BUFFER, platformVertices.size() * sizeof(float), platformVertices.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, platformEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, platformIndices.size() * sizeof(unsigned int), platformIndices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, platformIndices.size() * sizeof(unsigned short), platformIndices.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
         glEnableVertexAttribArray(0);
@@ -623,6 +692,14 @@ int main()
     }
 
 
+    // Σݼ tools/terraingen ɣں̨߳зֿ黻뻻Դౣ64
+    TerrainStream terrainStream("terrain.tiles", 64, 24.0f);
+    if (terrainStream.IsOpen()) {
+        // ݼĶ׼䣬ڵεƽ߶
+        glm::vec2 extent = terrainStream.Extent();
+        terrainStream.Origin = glm::vec3(cubePos.x - extent.x / 2, cubePos.y - 0.5f - terrainStream.Header.HeightScale / 2, cubePos.z - extent.y / 2);
+    }
+
     // ѩ
     std::vector<SnowParticle> snowParticles;
 
@@ -657,6 +734,7 @@ int main()
     float boxUpCenter = 1.18f;
     float boxDownCenter = 0.12f;
     float boxRadius = 0.40f;
+    const SnowCollider treeCollider = { boxUpCenter, boxDownCenter, boxRadius }; // ѩ䵽Χڼ
 
     float christmasTreeBoxVertices[] = {
         -boxRadius, boxDownCenter, 0.0f, 1.0f, 1.0f, 1.0f,
@@ -755,6 +833,59 @@ int main()
         }
     }
 
+    // LTC ԴԴͬԴұ tools/ltcfit Ԥ
+    AreaLightLTC areaLight;
+    areaLight.Center = areaLightPos - glm::vec3(0.0f, 0.01f, 0.0f); // Դ±
+    areaLight.HalfSize = glm::vec2(0.16f);
+    areaLight.Load("textures/ltc.bin");
+
+    // ۴ǰգΪԴ
+    ClusteredLights clusterLights;
+    const glm::mat4 lightParticleModel = glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, -0.19f, -0.25f)), glm::vec3(0.19f, 0.20f, 0.19f));
+
+    // ӰԴԴһӰͼ̬ͶȻֻʧЧԴƶʱػ
+    const int shadowMapSize = 512;
+    Shader shadowShader("shaders/lightcube.vs.glsl", "shaders/shadow.fs.glsl");
+    // ʥҶӰ͸ȲüͼҲҪõεıϸֽ׶ɣԼǰ׶ֻдȣ
+    // дӰͼ
+    Shader cutoutShadowShader("shaders/shadow_cutout.vs.glsl", "shaders/shadow_cutout.fs.glsl");
+    Shader terrainShadowShader("shaders/terrain.vert.glsl", "shaders/shadow.fs.glsl", "shaders/terrain.tesc.glsl", "shaders/terrain.tese.glsl", "shaders/terrain.gs.glsl");
+    CachedShadowMap pointShadow(shadowMapSize, 15, 0.01f, 3.0f);
+    CachedShadowMap areaShadow(shadowMapSize, 16, 0.01f, 3.0f);
+    unsigned int shadowCasterState = 0; // ̬Ͷ״ʾغ͵ϸּ
+    AsyncQuery shadowTimeQuery(GL_TIME_ELAPSED);
+    // Ĭָ 0 ԪĶάͳͻӰָԵĵԪ
+    for (Shader* receiver : { &lightingShader, &christmasTreeShader, &terrainShader }) {
+        receiver->use();
+        pointShadow.Apply(*receiver, "pointShadow", false);
+    }
+    areaLightingShader.use();
+    areaShadow.Apply(areaLightingShader, "areaShadow", false);
+
+    // --bench-area-lightȽϵԴ LTC ԴƬɫ˳
+    if (argc > 1 && std::string(argv[1]) == "--bench-area-light") {
+        benchmarkAreaLight(areaLightingShader, areaLight, areaLightPosArray, SCR_WIDTH, SCR_HEIGHT);
+        return 0;
+    }
+
+    // --bench-clusteredȽϱйԴֻڹԴƬɫ˳
+    if (argc > 1 && std::string(argv[1]) == "--bench-clustered") {
+        benchmarkClusteredLights(areaLightingShader, SCR_WIDTH, SCR_HEIGHT);
+        return 0;
+    }
+
+    // --bench-depth-sort͸ͼԪĺʱ˳
+    if (argc > 1 && std::string(argv[1]) == "--bench-depth-sort") {
+        benchmarkDepthSort();
+        return 0;
+    }
+
+    // --bench-draw-listбڲͬµ׼߳ϵͳύʱ˳
+    if (argc > 1 && std::string(argv[1]) == "--bench-draw-list") {
+        benchmarkDrawList(lightingShader, lightCubeVAO, SCR_WIDTH, SCR_HEIGHT);
+        return 0;
+    }
+
     // ܵ
     glm::vec3 controlPoints[] = {
         {-0.5f,  0.0f,  0.0f},
@@ -762,13 +893,12 @@ int main()
         { 0.2f,  1.0f,  1.0f},
         { 0.5f,  0.0f,  0.0f}
     }; // ߿Ƶ
-    std::vector<float> pipeVertices;
-    std::vector<unsigned int> pipeIndices;
     std::vector<float> keySectionVertices[3]; // ؼ涥
     const int sampleNum = 256; // 
     const int segmentNum = 256; // ܵ
-    std::vector<glm::vec3> keySections[3];  // ؼ
-    std::vector<std::vector<glm::vec3>> sections(segmentNum);
+    const glm::vec3 pipeScale(0.25f, 0.12f, 0.12f); // ܵģ
+    PipeSweep pipe;
+    std::vector<glm::vec3> *keySections = pipe.KeySections;  // ؼ
 
     std::vector<glm::vec3> &rectangleSection = keySections[0]; // ν
     for (int i = 0; i < sampleNum; i++) {
@@ -802,115 +932,21 @@ int main()
         circleSection.push_back(glm::vec3(0.5f, glm::sin(angle) * 0.6f, glm::cos(angle) * 0.6f));
     }
 
-    // ֵܵαֵ
-    for (int i = 0; i < sampleNum; i++) {
-        glm::vec3 controlPoints1[] = {
-            keySections[0][i],
-            glm::vec3((keySections[0][i].x + keySections[1][i].x) / 2.0f,
-                      keySections[1][i].y, keySections[1][i].z),
-            keySections[1][i]
-        };
-        glm::vec3 controlPoints2[] = {
-            keySections[1][i],
-            glm::vec3((keySections[1][i].x + keySections[2][i].x) / 2.0f,
-                      keySections[1][i].y, keySections[1][i].z),
-            keySections[2][i]
-        };
-        int j = 0;
-        for (; j < segmentNum / 2; j++) {
-            float t = j / float(segmentNum / 2);
-            sections[j].push_back(bezier2(controlPoints1[0], controlPoints1[1], controlPoints1[2], t));
-        }
-        for (; j < segmentNum; j++) {
-            float t = (j - segmentNum / 2) / float(segmentNum / 2);
-            sections[j].push_back(bezier2(controlPoints2[0], controlPoints2[1], controlPoints2[2], t));
-        }
-    }
-
-    // ƫƹܵ
-    for (int i = 0; i < sections.size(); i++) {
-        float t = i / float(sections.size());
-        glm::vec3 offset = bezier3(controlPoints[0], controlPoints[1], controlPoints[2], controlPoints[3], t);
-        for (int j = 0; j < sampleNum; j++) {
-            sections[i][j] += offset;
-        }       
-    }
-
-    // ɹܵ
-    for (int i = 0; i < sections.size() - 1; i++) {
-        for (int j = 0; j < sampleNum; j++) {
-            pipeVertices.push_back(sections[i][j].x);
-            pipeVertices.push_back(sections[i][j].y);
-            pipeVertices.push_back(sections[i][j].z);
-
-            glm::vec3 normal = glm::cross(sections[i + 1][j] - sections[i][j], sections[i][(j + 1) % sampleNum] - sections[i][j]);
-            pipeVertices.push_back(normal.x);
-            pipeVertices.push_back(normal.y);
-            pipeVertices.push_back(normal.z);
-
-            pipeVertices.push_back(sections[i + 1][j].x);
-            pipeVertices.push_back(sections[i + 1][j].y);
-            pipeVertices.push_back(sections[i + 1][j].z);
-
-            pipeVertices.push_back(normal.x);
-            pipeVertices.push_back(normal.y);
-            pipeVertices.push_back(normal.z);
-        }
-    }
-
-    for (int i = 0; i < sections.size() - 1; i++) {
-        for (int j = 0; j < sampleNum; j++) {
-            int base1 = i * sampleNum * 2 + j * 2;
-            int base2 = i * sampleNum * 2 + (j + 1) * 2 % (sampleNum * 2);
-            pipeIndices.push_back(base1);
-            pipeIndices.push_back(base1 + 1);
-            pipeIndices.push_back(base2);
-            pipeIndices.push_back(base1 + 1);
-            pipeIndices.push_back(base2);
-            pipeIndices.push_back(base2 + 1);
-        }
-    }
+    // ܵɨӣڹؼֵرƫƣڶι㣬м
+    for (int i = 0; i < 4; i++)
+        pipe.ControlPoints[i] = controlPoints[i];
+    pipe.SetUniformSampling(segmentNum);
+    pipe.Generate();
+    pipe.Upload();
 
     // ɹؼ涥
-    for (int j = 0; j < sampleNum; j++) {
-        keySectionVertices[0].push_back(sections[0][j].x);
-        keySectionVertices[0].push_back(sections[0][j].y);
-        keySectionVertices[0].push_back(sections[0][j].z);
-    }
-    for (int j = 0; j < sampleNum; j++) {
-        keySectionVertices[1].push_back(sections[sections.size() / 2][j].x);
-        keySectionVertices[1].push_back(sections[sections.size() / 2][j].y);
-        keySectionVertices[1].push_back(sections[sections.size() / 2][j].z);
-    }
-    for (int j = 0; j < sampleNum; j++) {
-        keySectionVertices[2].push_back(sections[sections.size() - 1][j].x);
-        keySectionVertices[2].push_back(sections[sections.size() - 1][j].y);
-        keySectionVertices[2].push_back(sections[sections.size() - 1][j].z);
-    }
-
-    // ܵϢ
-    unsigned int VBO15, pipeVAO, pipeEBO;
-    {
-        glGenVertexArrays(1, &pipeVAO);
-        glGenBuffers(1, &VBO15);
-        glGenBuffers(1, &pipeEBO);
-        glBindVertexArray(pipeVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO15);
-        glBufferData(GL_ARRAY_BUFFER, pipeVertices.size() * sizeof(float), pipeVertices.data(), GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pipeEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, pipeIndices.size() * sizeof(unsigned int), pipeIndices.data(), GL_STATIC_DRAW);
-    
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-    
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    float keySectionRings[] = { 0.0f, 0.5f, pipe.Rings.back() };
+    for (int i = 0; i < 3; i++) {
+        for (const glm::vec3& p : pipe.EvaluateRing(keySectionRings[i])) {
+            keySectionVertices[i].push_back(p.x);
+            keySectionVertices[i].push_back(p.y);
+            keySectionVertices[i].push_back(p.z);
+        }
     }
 
     // ؼ涥Ϣ
@@ -965,88 +1001,502 @@ int main()
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    // --pipe-tolerance-curveӦ޵ı仯˳
+    if (argc > 1 && std::string(argv[1]) == "--pipe-tolerance-curve") {
+        std::cout << "uniform: " << pipe.TriangleCount() << " triangles" << std::endl;
+        for (float tolerance = 0.0001f; tolerance <= 0.0129f; tolerance *= 2.0f) {
+            pipe.SetAdaptiveSampling(segmentNum, tolerance, pipeScale);
+            pipe.Generate();
+            std::cout << "tolerance " << tolerance << ": " << pipe.Rings.size() << " rings x " << pipe.Samples.size() << " samples, "
+                      << pipe.TriangleCount() << " triangles" << std::endl;
+        }
+        return 0;
+    }
+
+    // GPU ֻܵϴƵ͹ؼ棬ϸɫӾɹܵ
+    GpuPipeSweep gpuPipe;
+    gpuPipe.Upload(pipe);
+    const float pipePixelsPerEdge = 8.0f; // GPU ܵϸֺÿߵĿس
+    AsyncQuery pipePrimitivesQuery(GL_PRIMITIVES_GENERATED);
+
+    // ͸ͼԪ򣺹Ӻ CPU ܵΰӺǰƣӽǺͼԪûʱϴε˳
+    DepthSort particleSort, pipeSort;
+    std::vector<unsigned int> pipeTriangles = pipe.TriangleList();
+    bool pipeTrianglesMoved = true;
+
+    // Ȩϵ˳޹͸ȣۻϳ׶һʱ
+    WeightedBlendedOIT oit;
+    AsyncQuery oitTimeQuery(GL_TIME_ELAPSED);
+
+    // ܷ֡CPU ׶κͶӦ GPU ʱP ƽֵͰٷλF9  Chrome trace
+    FrameProfiler profiler;
+
+    // ӳɫG-buffer ׶ε GPU ʱ
+    GBuffer gbuffer;
+    AsyncQuery geometryTimeQuery(GL_TIME_ELAPSED), lightingTimeQuery(GL_TIME_ELAPSED);
+
+    // ͸ǰƣѡֻдȵԤͳɫ׶ͨȲԵ
+    OpaqueQueue opaqueQueue;
+    Shader depthShader("shaders/depth.vs.glsl", "shaders/shadow.fs.glsl");
+    AsyncQuery depthPassTimeQuery(GL_TIME_ELAPSED), colorPassTimeQuery(GL_TIME_ELAPSED), colorPassSamplesQuery(GL_SAMPLES_PASSED);
+
+    // ɱιܵ· 5 ؼ棬ÿؼʱ 4 ״ѭֵȫڶɫ
+    const int morphKeyNum = 5; // ؼ
+    const int morphFrameNum = 4; // ؼ֡
+    std::vector<glm::vec3> morphShapes[morphFrameNum] = { rectangleSection, ellipseSection, circleSection, {} };
+    for (int i = 0; i < sampleNum; i++) { // ν
+        float angle = glm::radians(360.0f / sampleNum * i);
+        float radius = 0.55f + 0.12f * glm::sin(angle * 5.0f);
+        morphShapes[3].push_back(glm::vec3(0.0f, glm::sin(angle) * radius, glm::cos(angle) * radius));
+    }
+    std::vector<glm::vec3> morphSections;
+    for (int f = 0; f < morphFrameNum; f++)
+        for (int k = 0; k < morphKeyNum; k++)
+            for (const glm::vec3& p : morphShapes[(k + f) % morphFrameNum])
+                morphSections.push_back(glm::vec3(k / float(morphKeyNum - 1) - 0.5f, p.y, p.z)); // x عܵ -0.5  0.5
+    MorphingPipe morphPipe(segmentNum, sampleNum);
+    morphPipe.SetSections(morphKeyNum, morphFrameNum, pipe.ControlPoints, morphSections);
+
+    // ܵ pipeData  0 ԪϣĬҲָ 0 ŵԪͲͬʹʧܣ
+    // Ӱͼڵһλƹ֮ܵǰõ
+    for (Shader* program : { &gpuPipe.Program, &morphPipe.Program }) {
+        program->use();
+        areaLight.Apply(*program);
+        clusterLights.Apply(*program, clusteredLighting);
+        GBuffer::SetSamplers(*program);
+        areaShadow.Apply(*program, "areaShadow", false);
+    }
+
+    // ܵΧİ뾶 cubePosڿƵ͹ڣټϽİ뾶
+    auto pipeBoundingRadius = [&]() {
+        float radius = 0.0f;
+        for (const glm::vec3& point : pipe.ControlPoints)
+            radius = std::max(radius, glm::length(pipeScale * point));
+        return radius + pipeScale.y;
+    };
+
+    // ༭ܵ¹ؼ涥 GPU ܵݣresampled ʾ²εӹϵҲ
+    unsigned int keySectionVBOs[] = { VBO16, VBO17, VBO18 };
+    float syncedPipeRadius = pipeBoundingRadius(); // ϴͬʱܵΧİ뾶
+    bool pipeEditDragging = false; // һ֡Ƿƶ˿Ʊ
+    auto syncPipe = [&](bool resampled) {
+        for (int i = 0; i < 3; i++) {
+            std::vector<glm::vec3> ring = pipe.EvaluateRing(keySectionRings[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, keySectionVBOs[i]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, ring.size() * sizeof(glm::vec3), ring.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gpuPipe.Upload(pipe);
+        morphPipe.SetControlPoints(pipe.ControlPoints);
+        // ʱεֱӴӶ㣬ֻƶ˶ʱؽ
+        if (resampled)
+            pipeTriangles = pipe.TriangleList();
+        pipeTrianglesMoved = true;
+        // εĹܵǾ̬Ͷֻб༭ǰĹܵӰΧڵͼҪػ棻εĹܵÿ֡Ϊ̬Ͷ
+        float pipeRadius = pipeBoundingRadius();
+        if (!pipeMorphing) {
+            for (CachedShadowMap* shadow : { &pointShadow, &areaShadow })
+                if (glm::distance(shadow->Position, cubePos) < shadow->FarZ + std::max(pipeRadius, syncedPipeRadius))
+                    shadow->Invalidate();
+        }
+        syncedPipeRadius = pipeRadius;
+    };
+
+
+    // ʼӣ׼ÿͬһӣһ֡УͲſɱȽϣطʱʹ¼ʱ
+    unsigned int seed = replayingInput ? inputReplay.Seed : headless ? 1u : static_cast<unsigned int>(glfwGetTime() * 1000);
+    srand(seed);
+
+    // 糵ӵģ⣺Թ̶ƽģʽڵ߳УȾص
+    // ׼ԺطȾ߳а֡ʱƽɸ
+    SimulationState initialSimulation;
+    initialSimulation.WindmillAngle = windmillAngle;
+    initialSimulation.Snow = snowParticles;
+    initialSimulation.Lights = lightParticles;
+    Simulation simulation(initialSimulation, treeCollider);
+    if (!headless && !replayingInput)
+        simulation.Start(seed);
+
+    // ׼Խűõĳ
+    HeadlessBenchmark benchmark(benchmarkScript, {
+        { "snow", &snowAppear }, { "lights", &isLightOn }, { "table", &tableDisplay }, { "blackboard", &blackboardDisplay },
+        { "windmill", &windmillAppear }, { "windmill-colorful", &windmillColorful }, { "windmill-rotate", &windmillRotate },
+        { "terrain-stream", &terrainStreamDisplay }, { "deferred", &deferredShading }, { "shadows", &shadowsEnabled },
+        { "depth-prepass", &depthPrePass }, { "transparent-sorting", &transparentSorting }, { "oit", &weightedBlendedOIT },
+        { "clustered", &clusteredLighting }, { "ltc", &areaLightLTC }, { "pipe-gpu", &pipeOnGpu }, { "pipe-morph", &pipeMorphing },
+    });
+
+    if (!inputRecordPath.empty() && !inputRecorder.Open(inputRecordPath, seed, glfwGetTime()))
+        return -1;
+    int replayFrames = 0;
+
+    // ׼׶ÿ֡ɵбύ׶ GL ߳ط
+    DrawList windmillLines, windmillFaces, windmillCasters;
 
-    // ʼ
-    srand(static_cast<unsigned int>(glfwGetTime() * 1000));
+    // ֡ʱӺ֡
+    FramePacer framePacer;
+    double refreshRate = 0.0; // ʾˢʣ0 Ϊδ֪
 
     // Ⱦѭ
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (headless ? benchmark.Running() : !glfwWindowShouldClose(window))
     {
-        // ʱ߼
+        // ʱ߼׼ԺطŰ̶ʱ䲽ƽ
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        double frameTime = headless ? benchmark.Time() : replayingInput ? replayFrames++ * replayTimestep : framePacer.Now();
+        float currentFrame = static_cast<float>(frameTime); // ɫеĶʱ
+        deltaTime = static_cast<float>(frameTime - lastFrame);
+        lastFrame = frameTime;
 
-        // 
-        // -----
-        processInput(window);
+        // ܷÿ֡ CPU  GPU ʱ䣬Ⱦѭĸ׶ ProfileScope 
+        profiler.BeginFrame();
 
-        // 糵ת
-        if (windmillRotate) {
-            windmillAngle += windmillSpeed * deltaTime;
-            windmillAngle = windmillAngle - static_cast<int>(windmillAngle) + static_cast<int>(windmillAngle) % 360;
+        // 룺׼ɽűλúͳ
+        // -----
+        int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
+        if (headless)
+            benchmark.BeginFrame();
+        else
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (replayingInput) {
+            // ͻ¼еһʱΪֹ¼סļɻطŵİ״̬
+            inputReplay.Deliver(currentFrame,
+                [&](int key, int scancode, int action, int mods) { key_callback(window, key, scancode, action, mods); },
+                [&](float x, float y) { mouse_callback(window, x, y); },
+                [&](float x, float y) { scroll_callback(window, x, y); });
+            processInput(window);
+            if (!headless && inputReplay.Finished(currentFrame))
+                glfwSetWindowShouldClose(window, true);
+        } else if (headless) {
+            BenchmarkScript::CameraKey pose = benchmark.Script.CameraAt(currentFrame);
+            camera = Camera(pose.Position, glm::vec3(0.0f, 1.0f, 0.0f), pose.Yaw, pose.Pitch);
+        } else {
+            processInput(window);
         }
 
+        // ¶Ӻ͹ܵ
+        {
+        CpuScope updateScope("update");
+        // ȡģղֵ֡ķ糵ǶȺλãģⱾ֡ʱ仯
+        simulation.SetControls(windmillRotate, windmillSpeed, snowAppear, isLightOn);
+        simulation.NudgeWindmill(windmillNudge);
+        windmillNudge = 0.0f;
+        // ģʱ˫ȵ֡ʱ䣬ȵʱо˷ֱ治֡
+        if (!simulation.IsThreaded())
+            simulation.AdvanceTo(frameTime);
+        simulation.Interpolate(simulation.IsThreaded() ? simulation.Now() : frameTime, windmillAngle, snowParticles, lightParticles);
+
         // ѩ
         if (snowAppear) {
-            for (auto& particle : snowParticles) {
-                particle.position += particle.velocity * deltaTime;
-
-                float x = particle.position.x;
-                float y = particle.position.y;
-                float z = particle.position.z;
-
-                auto tmp = (boxUpCenter - y) / (boxUpCenter - boxDownCenter) * boxRadius;
-
-                // ʥΧײ
-                if (y < 0.0f || ((y <= boxUpCenter || y >= boxDownCenter) && x * x + z * z < tmp * tmp)) {
-                    initSnowParticle(particle);
-                }
-            }
             glBindBuffer(GL_ARRAY_BUFFER, VBO12);
             glBufferSubData(GL_ARRAY_BUFFER, 0, snowParticles.size() * sizeof(SnowParticle), snowParticles.data());
         }
 
         // ¹
         if (isLightOn) {
-            for (auto& particle : lightParticles) {
-                particle.position += particle.velocity * deltaTime;
-
-                float x = particle.position.x;
-                float y = particle.position.y;
-                float z = particle.position.z;               
-
-                if (x * x + z * z > 0.48f * 0.48f) {
-                    particle.velocity.x *= -1;
-                    particle.velocity.z *= -1;
-                }
-
-                if (y < 0.05f || y > 1.12f) {
-                    particle.velocity.y *= -1;
-                }
-
-            }
             glBindBuffer(GL_ARRAY_BUFFER, VBO14);
             glBufferSubData(GL_ARRAY_BUFFER, 0, lightParticles.size() * sizeof(LightParticle), lightParticles.data());
         }
 
+        // ༭ֻܵ¼ӰĻֻϴЩӦĻ
+        if (pipeEditMove != glm::vec3(0.0f)) {
+            if (pipeEditHandle < 4)
+                pipe.MoveControlPoint(pipeEditHandle, pipe.ControlPoints[pipeEditHandle] + pipeEditMove);
+            else
+                pipe.MoveKeySection(pipeEditHandle - 4, pipeEditMove);
+            pipeEditMove = glm::vec3(0.0f);
+            // GPU ֻܵϴµĿƵͽ棬CPU лʱٸ
+            if (pipeOnGpu || pipeMorphing)
+                syncPipe(false);
+            pipeEditDragging = true;
+        } else if (pipeEditDragging) {
+            // ӦЩͲȡ״϶ʱԭĲֻӰĻ
+            // ɿ˳༭ģʽѡȡһ
+            pipeEditDragging = false;
+            if (pipeAdaptive)
+                pipeResampleRequested = true;
+        }
+
+        // ²ܵ
+        if (pipeResampleRequested) {
+            pipeResampleRequested = false;
+            if (pipeAdaptive)
+                pipe.SetAdaptiveSampling(segmentNum, pipeTolerance, pipeScale);
+            else
+                pipe.SetUniformSampling(segmentNum);
+            pipe.Generate();
+            pipe.Upload();
+            syncPipe(true);
+        }
+        if (!pipeOnGpu && !pipeMorphing && pipe.Update())
+            syncPipe(false);
+        }
+
+        // ׼׶Σϵͳϲмͨбģ;ɫƷΧ͹ӵĵԴ
+        //  OpenGL֮ύ׶ֻ GL ߳ϰб uniform 
+        // ------
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        {
+        CpuScope prepareScope("prepare");
+        Frustum cameraFrustum(projection * view);
+        JobSystem& jobs = JobSystem::Instance();
+        JobGroup prepareJobs;
+
+        // 糵ƬҶƬÿƬɣֱУÿƬһƬת 90 ȣ
+        // ߻ҶƬǰһ㣬ӰֻҪҶƬ
+        const glm::vec3 windmillCenter = cubePos + glm::vec3(0.0f, 0.08f, -0.4898f);
+        auto windmillBlade = [&](int i, float z, DrawCommand& command) {
+            command.Model = glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, 0.08f, z));
+            command.Model = glm::scale(command.Model, glm::vec3(0.2f, 0.2f, 0.02f));
+            command.Model = glm::rotate(command.Model, glm::radians(windmillAngle + 90.0f * (i / 2)), glm::vec3(0.0f, 0.0f, 1.0f));
+            command.VAO = i % 2 ? Windmill2VAO : Windmill1VAO;
+            command.Count = 3;
+        };
+        jobs.Run(prepareJobs, [&]() {
+            windmillLines.Prepare(windmillAppear ? 8 : 0, [&](int i, DrawCommand& command) {
+                windmillBlade(i, -0.4897f, command);
+                command.Mode = GL_LINE_LOOP;
+                command.Visible = cameraFrustum.Intersects(windmillCenter, 0.15f);
+            });
+        });
+        jobs.Run(prepareJobs, [&]() {
+            windmillFaces.Prepare(windmillColorful ? 8 : 0, [&](int i, DrawCommand& command) {
+                windmillBlade(i, -0.4898f, command);
+                command.Color = glm::vec3(windmillColor[i * 3], windmillColor[i * 3 + 1], windmillColor[i * 3 + 2]);
+                command.Visible = cameraFrustum.Intersects(windmillCenter, 0.15f);
+            });
+        });
+        jobs.Run(prepareJobs, [&]() {
+            windmillCasters.Prepare(shadowsEnabled && blackboardDisplay && windmillColorful ? 8 : 0, [&](int i, DrawCommand& command) {
+                windmillBlade(i, -0.4898f, command);
+            });
+        });
+
+        // ΪԴ䵽׶Ĵ
+        jobs.Run(prepareJobs, [&]() {
+            clusterLights.Lights.resize(isLightOn && tableDisplay ? lightParticles.size() : 0);
+            parallelFor((int)clusterLights.Lights.size(), [&](int i) {
+                const LightParticle& particle = lightParticles[i];
+                // ɫͬ˸
+                float flash = 0.75f + 0.25f * glm::sin((currentFrame + particle.flashDelTime) * 5.0f);
+                glm::vec3 position = glm::vec3(lightParticleModel * glm::vec4(particle.position, 1.0f));
+                clusterLights.Lights[i] = { position, particleLightRadius, particle.color * flash * particleLightIntensity };
+            });
+        });
+        jobs.Wait(prepareJobs);
+        }
+
         // ʼȾ
         // ------
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // Ӱͼ̬ͶֻڻʧЧԴƶʱػ棬̬Ͷÿ֡ڻĸ
+        unsigned int casterState = blackboardDisplay | tableDisplay << 1 | pipeMorphing << 2 | pipeOnGpu << 3 | inner << 4 | outer << 12;
+        if (casterState != shadowCasterState) {
+            shadowCasterState = casterState;
+            pointShadow.Invalidate();
+            areaShadow.Invalidate();
+        }
+        glm::mat4 pipeModel = glm::scale(glm::translate(glm::mat4(1.0f), cubePos), pipeScale); // ܵ任
+        if (shadowsEnabled) {
+            ProfileScope shadowScope(profiler, "shadows");
+            // ̬Ͷڰ塢ӡʥΡƽ̨ԼεĹܵ
+            // ǰסԴ͹Уǽڵڵκα棬ӰͼֻǽϲӰ
+            auto drawStaticCasters = [&](const glm::mat4& lightView, const glm::mat4& lightProjection) {
+                shadowShader.use();
+                shadowShader.setMat4("view", lightView);
+                shadowShader.setMat4("projection", lightProjection);
+                // ڰΪһͶӰ
+                if (blackboardDisplay) {
+                    shadowShader.setMat4("model", glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, 0.08f, -0.49f)), glm::vec3(0.6f, 0.4f, 0.02f)));
+                    glBindVertexArray(lightCubeVAO);
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                }
+                if (!pipeMorphing && !pipeOnGpu) {
+                    shadowShader.setMat4("model", pipeModel);
+                    pipe.Draw();
+                } else if (!pipeMorphing) {
+                    // д G-buffer ķ֧գͼֻҪȣϸְӰͼķֱ
+                    gpuPipe.Program.use();
+                    gpuPipe.Program.setBool("writeGBuffer", true);
+                    gpuPipe.Program.setMat4("model", pipeModel);
+                    gpuPipe.Program.setMat4("view", lightView);
+                    gpuPipe.Program.setMat4("projection", lightProjection);
+                    gpuPipe.Program.setVec3("viewPos", glm::vec3(glm::inverse(lightView)[3]));
+                    gpuPipe.Program.setFloat("detail", shadowMapSize / 2.0f / pipePixelsPerEdge);
+                    gpuPipe.Draw();
+                }
+                // ϵʥƽ̨͵һʾ
+                if (tableDisplay) {
+                    shadowShader.use();
+                    glm::mat4 casterModel = glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(-0.25f, -0.4999f, -0.125f));
+                    casterModel = glm::scale(casterModel, glm::vec3(0.01f, 0.01f, 0.01f));
+                    casterModel = glm::rotate(casterModel, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                    shadowShader.setMat4("model", casterModel);
+                    tableModel.Draw(shadowShader);
+                    casterModel = glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(-0.0f, -0.180f, -0.25f));
+                    casterModel = glm::scale(casterModel, glm::vec3(0.10f, 0.10f, 0.10f));
+                    cutoutShadowShader.use();
+                    cutoutShadowShader.setMat4("view", lightView);
+                    cutoutShadowShader.setMat4("projection", lightProjection);
+                    cutoutShadowShader.setMat4("model", casterModel);
+                    cutoutShadowShader.setFloat("alphaCutoff", 0.2f);
+                    christmasTreeModel.Draw(cutoutShadowShader);
+                    shadowShader.use();
+                    shadowShader.setMat4("model", glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, -0.1899f, -0.25f)), glm::vec3(0.20f, 0.020f, 0.20f)));
+                    glBindVertexArray(platformVAO);
+                    glDrawElements(GL_TRIANGLE_STRIP, platformIndices.size(), GL_UNSIGNED_SHORT, 0);
+
+                    // εıϸɫɣֻдȵĵγƣϸ̶ֹͼ仯
+                    terrainShadowShader.use();
+                    terrainShadowShader.setInt("inner", inner);
+                    terrainShadowShader.setInt("outer", outer);
+                    terrainShadowShader.setBool("adaptive", false);
+                    terrainShadowShader.setMat4("view", lightView);
+                    terrainShadowShader.setMat4("projection", lightProjection);
+                    terrainShadowShader.setMat4("model", glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, -0.1900f, -0.25f)), glm::vec3(0.20f, 0.020f, 0.20f)));
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, terrainHeightmap.Texture);
+                    terrainShadowShader.setInt("heightMap", 0);
+                    glBindVertexArray(terrainVAO);
+                    glDrawElements(GL_PATCHES, terrainIndices.size(), GL_UNSIGNED_SHORT, 0);
+                }
+            };
+
+            // ̬Ͷ糵ͱεĹܵ
+            auto drawWindmill = [&](const glm::mat4& lightView, const glm::mat4& lightProjection) {
+                shadowShader.use();
+                shadowShader.setMat4("view", lightView);
+                shadowShader.setMat4("projection", lightProjection);
+                windmillCasters.Submit(shadowShader);
+            };
+            auto drawMorphingPipe = [&](const glm::mat4& lightView, const glm::mat4& lightProjection) {
+                morphPipe.Program.use();
+                morphPipe.Program.setBool("writeGBuffer", true);
+                morphPipe.Program.setMat4("model", pipeModel);
+                morphPipe.Program.setMat4("view", lightView);
+                morphPipe.Program.setMat4("projection", lightProjection);
+                morphPipe.Draw(currentFrame);
+            };
+
+            shadowTimeQuery.Begin();
+            for (CachedShadowMap* shadow : { &pointShadow, &areaShadow }) {
+                // ԴӰӾ·ȾܿԴĺ
+                shadow->Update(shadow == &pointShadow ? lightPos : areaLight.Center - glm::vec3(0.0f, 0.005f, 0.0f), drawStaticCasters);
+                if (blackboardDisplay && windmillColorful)
+                    shadow->DrawDynamic(cubePos + glm::vec3(0.0f, 0.08f, -0.4898f), 0.15f, drawWindmill);
+                if (pipeMorphing) {
+                    shadow->DrawDynamic(cubePos, pipeBoundingRadius(), drawMorphingPipe);
+                }
+            }
+            shadowTimeQuery.End();
+        }
+
         // ȷ Uniforms/Drawing ʱ Shader
         //---------------------------------------------------------------------
         lightingShader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
+        pointShadow.Apply(lightingShader, "pointShadow", shadowsEnabled);
         glm::mat4 model = glm::mat4(1.0f);
 
+        clusterLights.Build(view, projection, 0.1f, 100.0f, framebufferWidth, framebufferHeight);
+
+        // ֻдȵĻƣλɫʱļȫͬƬɫΪ
+        auto depthDraw = [&](const glm::mat4& objectModel, std::function<void()> draw) {
+            return [&, objectModel, draw]() {
+                depthShader.use();
+                depthShader.setMat4("projection", projection);
+                depthShader.setMat4("view", view);
+                depthShader.setMat4("model", objectModel);
+                draw();
+            };
+        };
+
+        // ƹܵӳɫʱֻѱд G-buffer
+        bool pipeOpaque = pipeColorA >= 1.0f;
+        bool sortTransparent = transparentSorting && !weightedBlendedOIT;
+        bool pipeDeferred = deferredShading && pipeOpaque;
+        // ÿλӽǶӦϸֶʹϸֺıĻԼΪ pipePixelsPerEdge 
+        float pipeDetail = framebufferHeight / (2.0f * glm::tan(glm::radians(camera.Zoom) / 2.0f)) / pipePixelsPerEdge;
+        // ܵε uniformϸּȡ viewPos  detailԤɫһ
+        // ɵıȫͬɫʱ GL_EQUAL ȲԲͨ
+        auto setPipeGeometry = [&](Shader& pipeShader) {
+            pipeShader.setMat4("projection", projection);
+            pipeShader.setMat4("view", view);
+            pipeShader.setMat4("model", pipeModel);
+            pipeShader.setVec3("viewPos", camera.Position);
+            pipeShader.setFloat("detail", pipeDetail);
+        };
+        auto drawPipe = [&]() {
+            ProfileScope pipeScope(profiler, "pipe");
+            Shader& pipeShader = pipeMorphing ? morphPipe.Program : pipeOnGpu ? gpuPipe.Program : areaLightingShader;
+            pipeShader.use();
+            {
+                pipeShader.setBool("writeGBuffer", pipeDeferred);
+                pipeShader.setBool("weightedBlended", !pipeOpaque && weightedBlendedOIT);
+                pipeShader.setBool("useLTC", areaLightLTC && areaLight.IsLoaded());
+                areaLight.Apply(pipeShader);
+                areaShadow.Apply(pipeShader, "areaShadow", shadowsEnabled);
+                clusterLights.Apply(pipeShader, clusteredLighting);
+                pipeShader.setVec3Array("lightPos", areaLightPosArray);
+                pipeShader.setInt("lightNum", areaLightPosArray.size());
+                pipeShader.setVec3("lightColor", areaLightColor);
+                pipeShader.setVec4("albedo", pipeColorR, pipeColorG, pipeColorB, pipeColorA);
+                pipeShader.setFloat("metallic", pipeMetallic);
+                pipeShader.setFloat("roughness", pipeRoughness);
+                pipeShader.setFloat("specular", pipeSpecular);
+                setPipeGeometry(pipeShader);
+
+                if (pipeMorphing) {
+                    morphPipe.Draw(currentFrame);
+                } else if (pipeOnGpu) {
+                    pipePrimitivesQuery.Begin();
+                    gpuPipe.Draw();
+                    pipePrimitivesQuery.End();
+                } else if (!pipeOpaque && sortTransparent) {
+                    pipeSort.Draw(pipe.VAO, GL_TRIANGLES, pipe.EBO);
+                } else {
+                    pipe.Draw();
+                }
+            }
+        };
+
+        // ܵȣGPU ϸֺαĹֻܵԼĳɶ㣬д G-buffer ķ֧ռ㣬ɫдѹر
+        auto drawPipeDepth = [&]() {
+            if (!pipeMorphing && !pipeOnGpu) {
+                depthDraw(pipeModel, [&]() { pipe.Draw(); })();
+                return;
+            }
+            Shader& pipeShader = pipeMorphing ? morphPipe.Program : gpuPipe.Program;
+            pipeShader.use();
+            pipeShader.setBool("writeGBuffer", true);
+            setPipeGeometry(pipeShader);
+            if (pipeMorphing)
+                morphPipe.Draw(currentFrame);
+            else
+                gpuPipe.Draw();
+        };
+
         areaLightingShader.use();
+        // ԴԴеǿȾ̯Ϊ
+        areaLight.Radiance = areaLightColor * float(areaLightPosArray.size()) / (4.0f * areaLight.HalfSize.x * areaLight.HalfSize.y);
+        areaLightingShader.setBool("useLTC", areaLightLTC && areaLight.IsLoaded());
+        areaLight.Apply(areaLightingShader);
+        areaShadow.Apply(areaLightingShader, "areaShadow", shadowsEnabled);
+        clusterLights.Apply(areaLightingShader, clusteredLighting);
+        areaLightingShader.setBool("writeGBuffer", deferredShading);
+        areaLightingShader.setBool("weightedBlended", false);
+
+        // Ͳ͸Ĺܵ벻͸Уǰɫʱϵһǰƣ
+        // ӳɫʱȵд G-bufferG-buffer ֻҪı棬Ԥ
+        opaqueQueue.Begin(view, depthPrePass && !deferredShading);
+        glm::mat4 roomModel = glm::translate(glm::mat4(1.0f), cubePos);
+
         //컨
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, 0.5f, 0.0f), depthDraw(roomModel, [&]() { glBindVertexArray(CeilingVAO); glDrawArrays(GL_TRIANGLES, 0, 6); }), [&]() {
+            ProfileScope roomScope(profiler, "room");
+            areaLightingShader.use();
             //ùղ
             areaLightingShader.setVec3("viewPos", camera.Position);
             areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
@@ -1062,17 +1512,17 @@ int main()
             areaLightingShader.setMat4("view", view);
 
             // 任
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(1.0f));
-            areaLightingShader.setMat4("model", model);
+            areaLightingShader.setMat4("model", roomModel);
 
             // Ⱦ
             glBindVertexArray(CeilingVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
+        });
 
         // Ƶذ
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, -0.5f, 0.0f), depthDraw(roomModel, [&]() { glBindVertexArray(FloorVAO); glDrawArrays(GL_TRIANGLES, 0, 6); }), [&]() {
+            ProfileScope roomScope(profiler, "room");
+            areaLightingShader.use();
             //ùղ
             areaLightingShader.setVec3("viewPos", camera.Position);
             areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
@@ -1088,18 +1538,17 @@ int main()
             areaLightingShader.setMat4("view", view);
 
             // 任
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(1.0f));
-            areaLightingShader.setMat4("model", model);
+            areaLightingShader.setMat4("model", roomModel);
 
             // Ⱦ
             glBindVertexArray(FloorVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
+        });
 
         // ǽ
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(-0.5f, 0.0f, 0.0f), depthDraw(roomModel, [&]() { glBindVertexArray(LWallVAO); glDrawArrays(GL_TRIANGLES, 0, 6); }), [&]() {
+            ProfileScope roomScope(profiler, "room");
+            areaLightingShader.use();
             //ùղ
             areaLightingShader.setVec3("viewPos", camera.Position);
             areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
@@ -1115,18 +1564,17 @@ int main()
             areaLightingShader.setMat4("view", view);
 
             // 任
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(1.0f));
-            areaLightingShader.setMat4("model", model);
+            areaLightingShader.setMat4("model", roomModel);
 
             // Ⱦ
             glBindVertexArray(LWallVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
+        });
 
         // ǽ
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(0.5f, 0.0f, 0.0f), depthDraw(roomModel, [&]() { glBindVertexArray(RWallVAO); glDrawArrays(GL_TRIANGLES, 0, 6); }), [&]() {
+            ProfileScope roomScope(profiler, "room");
+            areaLightingShader.use();
             //ùղ
             areaLightingShader.setVec3("viewPos", camera.Position);
             areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
@@ -1142,18 +1590,17 @@ int main()
             areaLightingShader.setMat4("view", view);
 
             // 任
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(1.0f));
-            areaLightingShader.setMat4("model", model);
+            areaLightingShader.setMat4("model", roomModel);
 
             // Ⱦ
             glBindVertexArray(RWallVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
+        });
 
         // ǰǽ
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, 0.0f, -0.5f), depthDraw(roomModel, [&]() { glBindVertexArray(FWallVAO); glDrawArrays(GL_TRIANGLES, 0, 6); }), [&]() {
+            ProfileScope roomScope(profiler, "room");
+            areaLightingShader.use();
             //ùղ
             areaLightingShader.setVec3("viewPos", camera.Position);
             areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
@@ -1169,18 +1616,45 @@ int main()
             areaLightingShader.setMat4("view", view);
 
             // 任
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(1.0f));
-            areaLightingShader.setMat4("model", model);
+            areaLightingShader.setMat4("model", roomModel);
 
             // Ⱦ
             glBindVertexArray(FWallVAO);
             glDrawArrays(GL_TRIANGLES, 0, 6);
+        });
+
+        // ͸Ĺܵ뷿һ
+        if (pipeOpaque)
+            opaqueQueue.Add(cubePos, drawPipeDepth, drawPipe);
+
+        // ӳɫ͹ܵд G-buffer G-buffer еıգÿɼֻһ BRDF֮Ȼǰɫ
+        if (deferredShading) {
+            gbuffer.Resize(framebufferWidth, framebufferHeight);
+            gbuffer.BeginGeometryPass();
+            geometryTimeQuery.Begin();
+            {
+                ProfileScope geometryScope(profiler, "G-buffer");
+                opaqueQueue.Draw();
+            }
+            geometryTimeQuery.End();
+            gbuffer.EndGeometryPass();
+
+            areaLightingShader.use();
+            areaLightingShader.setBool("writeGBuffer", false);
+            lightingTimeQuery.Begin();
+            {
+                ProfileScope lightingScope(profiler, "deferred lighting");
+                gbuffer.LightingPass(areaLightingShader, view, projection);
+            }
+            lightingTimeQuery.End();
+
+            opaqueQueue.Begin(view, depthPrePass);
         }
         
         // ƺڰ
         if (blackboardDisplay) {
+        {
+        ProfileScope blackboardScope(profiler, "blackboard");
         // ƺڰ߿򲿷
         {
             lightingShader.setVec3("objectColor", 0.75f, 0.5f, 0.3f);
@@ -1314,362 +1788,61 @@ int main()
             glDrawArrays(GL_TRIANGLES, 0, 6);
         }
 
-        // Ʒ糵1
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
+        }
+
+        {
+        ProfileScope windmillScope(profiler, "windmill");
+        // 糵ıߺͲɫҶƬͨõ uniform ֻһΣҶƬľɫ׼׶εб
+        if (windmillAppear || windmillColorful) {
             lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
             lightingShader.setVec3("lightPos", lightPos);
             lightingShader.setVec3("viewPos", camera.Position);
-
             lightingShader.setMat4("projection", projection);
             lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
             glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
+            windmillLines.Submit(lightingShader, "objectColor");
+            windmillFaces.Submit(lightingShader, "objectColor");
         }
 
-        // Ʒ糵2
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
+        }
 
+        // ƵƷ
+        {
+            lightCubeShader.use();
+            lightCubeShader.setMat4("projection", projection);
+            lightCubeShader.setMat4("view", view);
             model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
+            model = glm::translate(model, lightPos + glm::vec3(0.0f, -0.0001f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.1f)); // a smaller cube
+            lightCubeShader.setMat4("model", model);
 
-            glBindVertexArray(Windmill2VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
+            glBindVertexArray(lightCubeVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
         }
 
-        // Ʒ糵3
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
+        glm::mat4 treeModel = glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(-0.0f, -0.180f, -0.25f)), glm::vec3(0.10f, 0.10f, 0.10f)); // ʥ任
 
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
+        // Ӻʥ
+        // ģ͵Ƭɫ͸ȶƬΣεϸֺͼɫ̫󣬶Ԥֻ
+        if (tableDisplay) {
+        // 
+        opaqueQueue.Add(cubePos + glm::vec3(-0.25f, -0.4f, -0.125f), nullptr, [&]() {
+            ProfileScope tableScope(profiler, "table");
+            christmasTreeShader.use();
+            clusterLights.Apply(christmasTreeShader, clusteredLighting);
+            pointShadow.Apply(christmasTreeShader, "pointShadow", shadowsEnabled);
+            christmasTreeShader.setVec3("lightAmbient", 0.5f * glm::vec3(1.0f, 1.0f, 1.0f));
+            christmasTreeShader.setVec3("lightDiffuse", 0.2f * glm::vec3(1.0f, 1.0f, 1.0f));
+            christmasTreeShader.setVec3("lightSpecular", glm::vec3(1.0f, 1.0f, 1.0f));
+            christmasTreeShader.setVec3("lightPos", lightPos);
+            christmasTreeShader.setVec3("viewPos", camera.Position);
 
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
+            christmasTreeShader.setFloat("alphaCutoff", weightedBlendedOIT ? 0.9f : 0.2f);
+            christmasTreeShader.setBool("weightedBlended", false);
 
-            glBindVertexArray(Windmill1VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵4
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵5
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵6
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵7
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵8
-        if (windmillAppear) {
-            lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4897f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glLineWidth(1.0f);
-            glDrawArrays(GL_LINE_LOOP, 0, 3);
-        }
-
-        // Ʒ糵1
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[0], windmillColor[1], windmillColor[2]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵2
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[3], windmillColor[4], windmillColor[5]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵3
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[6], windmillColor[7], windmillColor[8]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵4
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[9], windmillColor[10], windmillColor[11]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵5
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[12], windmillColor[13], windmillColor[14]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵6
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[15], windmillColor[16], windmillColor[17]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵7
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[18], windmillColor[19], windmillColor[20]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill1VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // Ʒ糵8
-        if (windmillColorful) {
-            lightingShader.setVec3("objectColor", windmillColor[21], windmillColor[22], windmillColor[23]);
-            lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("lightPos", lightPos);
-            lightingShader.setVec3("viewPos", camera.Position);
-
-            lightingShader.setMat4("projection", projection);
-            lightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, 0.08f, -0.4898f));
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.02f));
-            model = glm::rotate(model, glm::radians(windmillAngle + 270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            lightingShader.setMat4("model", model);
-
-            glBindVertexArray(Windmill2VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
-
-        // ƵƷ
-        {
-            lightCubeShader.use();
-            lightCubeShader.setMat4("projection", projection);
-            lightCubeShader.setMat4("view", view);
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, lightPos + glm::vec3(0.0f, -0.0001f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.1f)); // a smaller cube
-            lightCubeShader.setMat4("model", model);
-
-            glBindVertexArray(lightCubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-        }
-
-        // Ӻʥ
-        if (tableDisplay) {
-        // 
-        christmasTreeShader.use();
-        {
-            christmasTreeShader.setVec3("lightAmbient", 0.5f * glm::vec3(1.0f, 1.0f, 1.0f));
-            christmasTreeShader.setVec3("lightDiffuse", 0.2f * glm::vec3(1.0f, 1.0f, 1.0f));
-            christmasTreeShader.setVec3("lightSpecular", glm::vec3(1.0f, 1.0f, 1.0f));
-            christmasTreeShader.setVec3("lightPos", lightPos);
-            christmasTreeShader.setVec3("viewPos", camera.Position);
-
-            christmasTreeShader.setMat4("projection", projection);
-            christmasTreeShader.setMat4("view", view);
+            christmasTreeShader.setMat4("projection", projection);
+            christmasTreeShader.setMat4("view", view);
 
             //// render the loaded model
             model = glm::mat4(1.0f);
@@ -1678,62 +1851,87 @@ int main()
             model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
             christmasTreeShader.setMat4("model", model);
             tableModel.Draw(christmasTreeShader);
-        }        
+        });
         
-        // ʥ
-        {
+        // ʥȨ͸ʱ͸ƣ͸ҶƬԵٻһ
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, -0.1f, -0.25f), nullptr, [&]() {
+            ProfileScope treeScope(profiler, "tree");
+            christmasTreeShader.use();
+            clusterLights.Apply(christmasTreeShader, clusteredLighting);
+            pointShadow.Apply(christmasTreeShader, "pointShadow", shadowsEnabled);
             christmasTreeShader.setVec3("lightAmbient", 0.5f * glm::vec3(1.0f, 1.0f, 1.0f));
             christmasTreeShader.setVec3("lightDiffuse", 0.2f * glm::vec3(1.0f, 1.0f, 1.0f));
             christmasTreeShader.setVec3("lightSpecular", glm::vec3(1.0f, 1.0f, 1.0f));
             christmasTreeShader.setVec3("lightPos", lightPos);
             christmasTreeShader.setVec3("viewPos", camera.Position);
             christmasTreeShader.setBool("isLightOn", isLightOn);
+            christmasTreeShader.setFloat("alphaCutoff", weightedBlendedOIT ? 0.9f : 0.2f);
+            christmasTreeShader.setBool("weightedBlended", false);
 
             christmasTreeShader.setMat4("projection", projection);
             christmasTreeShader.setMat4("view", view);
 
             //// render the loaded model
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(-0.0f, -0.180f, -0.25f));
-            model = glm::scale(model, glm::vec3(0.10f, 0.10f, 0.10f));
-            christmasTreeShader.setMat4("model", model);
+            christmasTreeShader.setMat4("model", treeModel);
             christmasTreeModel.Draw(christmasTreeShader);
+        });
+
+        // ʴΣʴCPUϵĸ߶ͼɣֻϴGPUأƽ̨Ķ֮
+        if (terrainErosionRequested) {
+            terrainErosionRequested = false;
+            ProfileScope erosionScope(profiler, "erosion");
+            hydraulicErosion(terrainHeightmap, terrainHydraulic, 1);
+            thermalErosion(terrainHeightmap, terrainThermal, 10);
+            terrainHeightmap.Update(0, 0, terrainHeightmapSize, terrainHeightmapSize);
+            generatePlatformVertices();
+            glBindBuffer(GL_ARRAY_BUFFER, VBO11);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, platformVertices.size() * sizeof(float), platformVertices.data());
+            pointShadow.Invalidate();
+            areaShadow.Invalidate();
         }
 
         // Ƶ
-        terrainShader.use();
-        {
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, -0.1900f, -0.25f), nullptr, [&]() {
+            ProfileScope terrainScope(profiler, "terrain");
+            terrainShader.use();
+            pointShadow.Apply(terrainShader, "pointShadow", shadowsEnabled);
             terrainShader.setInt("inner", inner);
             terrainShader.setInt("outer", outer);
+            terrainShader.setBool("adaptive", terrainAdaptive);
+            terrainShader.setVec2("viewportSize", (float)framebufferWidth, (float)framebufferHeight);
+            terrainShader.setFloat("pixelsPerEdge", terrainPixelsPerEdge);
             
             terrainShader.setMat4("projection", projection);
             terrainShader.setMat4("view", view);
 
-            terrainShader.setVec3("color", 0.0f, 1.0f, 0.0f);
+            // ߿ͬһлƣ߿ɼɫƬɫ
+            terrainShader.setVec3("color", 0.0f, 0.0f, 0.0f);
+            terrainShader.setVec3("wireColor", 0.0f, 1.0f, 0.0f);
+            terrainShader.setFloat("wireWidth", 0.6f);
+            terrainShader.setVec3("lightPos", lightPos);
             model = glm::mat4(1.0f);
             model = glm::translate(model, cubePos + glm::vec3(0.0f, -0.1900f, -0.25f));
             model = glm::scale(model, glm::vec3(0.20f, 0.020f, 0.20f));
             terrainShader.setMat4("model", model);
 
-            glBindVertexArray(terrainVAO);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            glLineWidth(0.2f);
-            glDrawElements(GL_PATCHES, terrainIndices.size(), GL_UNSIGNED_INT, terrainIndices.data());
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-            terrainShader.setVec3("color", 0.0f, 0.0f, 0.0f);
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, -0.1901f, -0.25f));
-            model = glm::scale(model, glm::vec3(0.20f, 0.020f, 0.20f));
-            terrainShader.setMat4("model", model);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, terrainHeightmap.Texture);
+            terrainShader.setInt("heightMap", 0);
 
+            terrainPrimitivesQuery.Begin();
             glBindVertexArray(terrainVAO);
-            glDrawElements(GL_PATCHES, terrainIndices.size(), GL_UNSIGNED_INT, terrainIndices.data());
-        }
+            glDrawElements(GL_PATCHES, terrainIndices.size(), GL_UNSIGNED_SHORT, 0);
+            terrainPrimitivesQuery.End();
+        });
 
         // ƽ̨
-        lightingShader.use();
-        {
+        glm::mat4 platformModel = glm::scale(glm::translate(glm::mat4(1.0f), cubePos + glm::vec3(0.0f, -0.1899f, -0.25f)), glm::vec3(0.20f, 0.020f, 0.20f));
+        auto drawPlatform = [&]() {
+            glBindVertexArray(platformVAO);
+            glDrawElements(GL_TRIANGLE_STRIP, platformIndices.size(), GL_UNSIGNED_SHORT, 0);
+        };
+        opaqueQueue.Add(cubePos + glm::vec3(0.0f, -0.1899f, -0.25f), depthDraw(platformModel, drawPlatform), [&]() {
+            lightingShader.use();
             lightingShader.setVec3("objectColor", 0.4f, 0.3f, 0.2f);
             lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
             lightingShader.setVec3("lightPos", lightPos);
@@ -1741,19 +1939,58 @@ int main()
 
             lightingShader.setMat4("projection", projection);
             lightingShader.setMat4("view", view);
+            lightingShader.setMat4("model", platformModel);
 
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, -0.1899f, -0.25f));
-            model = glm::scale(model, glm::vec3(0.20f, 0.020f, 0.20f));
-            lightingShader.setMat4("model", model);
+            drawPlatform();
+        });
+        }
 
-            glBindVertexArray(platformVAO);
-            glDrawElements(GL_TRIANGLES, platformIndices.size(), GL_UNSIGNED_INT, platformIndices.data());
+        // ǰƲ͸壬ֻͳɫ׶ͨȲԵҪյƬ
+        {
+            ProfileScope opaqueScope(profiler, "opaque");
+            depthPassTimeQuery.Begin();
+            {
+                ProfileScope depthScope(profiler, "depth pre-pass");
+                opaqueQueue.DepthPass();
+            }
+            depthPassTimeQuery.End();
+            colorPassTimeQuery.Begin();
+            colorPassSamplesQuery.Begin();
+            opaqueQueue.ColorPass();
+            colorPassSamplesQuery.End();
+            colorPassTimeQuery.End();
         }
 
+        // Ⱦ
+        auto drawLightParticles = [&]() {
+            ProfileScope particlesScope(profiler, "particles");
+            lightPointShader.use();
+            lightPointShader.setBool("weightedBlended", weightedBlendedOIT);
+            lightPointShader.setMat4("projection", projection);
+            lightPointShader.setMat4("view", view);
+            lightPointShader.setFloat("time", currentFrame);
+
+            lightPointShader.setMat4("model", lightParticleModel);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, glowTexture);
+            if (sortTransparent) {
+                // ÿ֡ƶ˳ÿ֡
+                if (particleSort.Sort(view * lightParticleModel, (int)lightParticles.size(), [&](int i) { return lightParticles[i].position; }, true))
+                    particleSort.Upload();
+                particleSort.Draw(lightPointVAO, GL_POINTS);
+            } else {
+                glBindVertexArray(lightPointVAO);
+                glDrawArrays(GL_POINTS, 0, lightParticleCount);
+            }
+        };
+
+        // ϵİ͸
+        if (tableDisplay) {
         // Ⱦѩ
         snowShader.use();
         if (snowAppear) {
+            ProfileScope particlesScope(profiler, "particles");
             snowShader.setMat4("projection", projection);
             snowShader.setMat4("view", view);
 
@@ -1775,23 +2012,9 @@ int main()
 #endif
         }
 
-        // Ⱦ
-        lightPointShader.use();
-        if (isLightOn) {
-            lightPointShader.setMat4("projection", projection);
-            lightPointShader.setMat4("view", view);
-            lightPointShader.setFloat("time", glfwGetTime());
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos + glm::vec3(0.0f, -0.19f, -0.25f));
-            model = glm::scale(model, glm::vec3(0.19f, 0.20f, 0.19f));
-            lightPointShader.setMat4("model", model);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, glowTexture);
-            glBindVertexArray(lightPointVAO);
-            glDrawArrays(GL_POINTS, 0, lightParticleCount);
-        }
+        // ȾӣȨ͸ʱۻ
+        if (isLightOn && !weightedBlendedOIT)
+            drawLightParticles();
         }
 
         // Դ
@@ -1838,33 +2061,27 @@ int main()
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
-        // ƹܵ
-        areaLightingShader.use();
-        {
-            areaLightingShader.setVec3("viewPos", camera.Position);
-            areaLightingShader.setVec3Array("lightPos", areaLightPosArray);
-            areaLightingShader.setInt("lightNum", areaLightPosArray.size());
-            areaLightingShader.setVec3("lightColor", areaLightColor);
-            areaLightingShader.setVec4("albedo", pipeColorR, pipeColorG, pipeColorB, pipeColorA);
-            areaLightingShader.setFloat("metallic", pipeMetallic);
-            areaLightingShader.setFloat("roughness", pipeRoughness);
-            areaLightingShader.setFloat("specular", pipeSpecular);
-
-            areaLightingShader.setMat4("projection", projection);
-            areaLightingShader.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(0.25f, 0.12f, 0.12f));
-            areaLightingShader.setMat4("model", model);
-
-            glBindVertexArray(pipeVAO);
-            glDrawElements(GL_TRIANGLES, pipeIndices.size(), GL_UNSIGNED_INT, 0);
+        // ܵ͸ʱ治͸лƣ͸ʱ֮
+        if (!pipeOpaque && !weightedBlendedOIT) {
+            // GPU ϸֺαĹܵ GPU ɶ㣬ֻ CPU ܵ
+            if (sortTransparent && !pipeOnGpu && !pipeMorphing) {
+                ProfileScope sortScope(profiler, "pipe sort");
+                auto triangleCenter = [&](int i) {
+                    glm::vec3 center(0.0f);
+                    for (int k = 0; k < 3; k++)
+                        center += glm::vec3(pipe.Vertices[pipeTriangles[i * 3 + k] * 3], pipe.Vertices[pipeTriangles[i * 3 + k] * 3 + 1], pipe.Vertices[pipeTriangles[i * 3 + k] * 3 + 2]);
+                    return center / 3.0f;
+                };
+                if (pipeSort.Sort(view * pipeModel, (int)pipeTriangles.size() / 3, triangleCenter, pipeTrianglesMoved))
+                    pipeSort.Upload(&pipeTriangles, 3);
+                pipeTrianglesMoved = false;
+            }
+            drawPipe();
         }
 
         // ƹܵؼ
-        areaLightCubeShader.use();
-        {
+        if (!pipeMorphing) {
+            areaLightCubeShader.use();
             areaLightCubeShader.setVec3("lightColor", 0.0f, 1.0f, 0.04f);
             areaLightCubeShader.setInt("lightNum", 1);
             areaLightCubeShader.setMat4("projection", projection);
@@ -1872,7 +2089,7 @@ int main()
 
             model = glm::mat4(1.0f);
             model = glm::translate(model, cubePos);
-            model = glm::scale(model, glm::vec3(0.25f, 0.12f, 0.12f));
+            model = glm::scale(model, pipeScale);
             areaLightCubeShader.setMat4("model", model);
 
             glLineWidth(2.0f);
@@ -1887,12 +2104,153 @@ int main()
             glDrawArrays(GL_LINE_LOOP, 0, sampleNum);
         }
 
+        // ʽ
+        if (terrainStreamDisplay) {
+            ProfileScope streamScope(profiler, "stream terrain");
+            terrainStream.Update(camera.Position);
+
+            terrainStreamShader.use();
+            terrainStreamShader.setMat4("projection", projection);
+            terrainStreamShader.setMat4("view", view);
+            terrainStreamShader.setVec3("lightDir", -0.4f, -1.0f, -0.3f);
+            terrainStream.Draw(terrainStreamShader);
+        }
+
+        // Ȩϵ˳޹͸ȣв͸廭󣬹ӡ͸ܵʥҶƬİ͸Ե˳ۻһκϳɵ
+        if (weightedBlendedOIT) {
+            ProfileScope oitScope(profiler, "transparency");
+            oit.Resize(framebufferWidth, framebufferHeight);
+            oitTimeQuery.Begin();
+            oit.BeginAccumulation();
+            if (tableDisplay) {
+                if (isLightOn)
+                    drawLightParticles();
+                ProfileScope treeScope(profiler, "tree");
+                christmasTreeShader.use();
+                christmasTreeShader.setBool("weightedBlended", true);
+                christmasTreeShader.setMat4("model", treeModel);
+                christmasTreeModel.Draw(christmasTreeShader);
+            }
+            if (!pipeOpaque)
+                drawPipe();
+            oit.EndAccumulation();
+            oit.Resolve();
+            oitTimeQuery.End();
+        }
+
+        // ͳϢ
+        if (statsRequested) {
+            statsRequested = false;
+            terrainPrimitivesQuery.Collect();
+            std::cout << "point lights: " << clusterLights.Lights.size() << (clusteredLighting ? " clustered" : " unclustered") << ", "
+                      << clusterLights.OccupiedClusters << " of " << ClusteredLights::CLUSTER_COUNT << " clusters lit, "
+                      << clusterLights.IndexCount / float(std::max(clusterLights.OccupiedClusters, 1)) << " lights per lit cluster, at most " << clusterLights.MaxClusterLights
+                      << ", assigned in " << clusterLights.BuildMilliseconds << " ms" << std::endl;
+            geometryTimeQuery.Collect();
+            lightingTimeQuery.Collect();
+            auto queryMilliseconds = [](const AsyncQuery& query) { return query.HasResult ? query.Result / 1e6 : 0.0; };
+            if (deferredShading)
+                std::cout << "deferred shading: G-buffer " << queryMilliseconds(geometryTimeQuery) << " ms, lighting " << queryMilliseconds(lightingTimeQuery)
+                          << " ms, " << gbuffer.Width * gbuffer.Height * GBuffer::PixelBytes() / 1024 << " KB G-buffer" << std::endl;
+            depthPassTimeQuery.Collect();
+            colorPassTimeQuery.Collect();
+            colorPassSamplesQuery.Collect();
+            GLuint64 shadedSamples = colorPassSamplesQuery.HasResult ? colorPassSamplesQuery.Result : 0;
+            std::cout << "opaque: " << opaqueQueue.Draws << " draws front to back, depth pre-pass ";
+            if (opaqueQueue.PrePass)
+                std::cout << "of " << opaqueQueue.PrePassDraws << " in " << queryMilliseconds(depthPassTimeQuery) << " ms";
+            else
+                std::cout << "off";
+            std::cout << ", colour " << queryMilliseconds(colorPassTimeQuery) << " ms, " << shadedSamples << " samples shaded, "
+                      << shadedSamples / float(framebufferWidth * framebufferHeight) << " per pixel" << std::endl;
+            oitTimeQuery.Collect();
+            if (weightedBlendedOIT)
+                std::cout << "transparency: weighted blended OIT, accumulated and resolved in " << queryMilliseconds(oitTimeQuery) << " ms, "
+                          << oit.Width * oit.Height * WeightedBlendedOIT::PixelBytes() / 1024 << " KB targets" << std::endl;
+            else if (transparentSorting)
+                std::cout << "transparency: sorted, " << particleSort.Order.size() << " particles in " << particleSort.SortMilliseconds << " ms, "
+                          << pipeSort.Order.size() << " pipe triangles in " << pipeSort.SortMilliseconds << " ms, pipe sort skipped "
+                          << pipeSort.Skips << " of " << pipeSort.Sorts + pipeSort.Skips << " times with an unchanged view" << std::endl;
+            else
+                std::cout << "transparency: unsorted" << std::endl;
+            shadowTimeQuery.Collect();
+            if (shadowsEnabled)
+                std::cout << "shadows: static casters cached, rendered " << pointShadow.StaticRenders << " times for the point light and " << areaShadow.StaticRenders
+                          << " for the area light, " << pointShadow.DynamicFaces + areaShadow.DynamicFaces << " faces with dynamic casters, "
+                          << queryMilliseconds(shadowTimeQuery) << " ms" << std::endl;
+            else
+                std::cout << "shadows: off" << std::endl;
+            std::cout << "area light: " << (areaLightLTC && areaLight.IsLoaded() ? "LTC rectangle" : std::to_string(areaLightPosArray.size()) + " point lights") << std::endl;
+            std::cout << "pipe: " << (pipeAdaptive ? "adaptive" : "uniform") << " sampling";
+            if (pipeAdaptive)
+                std::cout << " within " << pipeTolerance;
+            std::cout << ", " << pipe.Rings.size() << " rings x " << pipe.Samples.size() << " samples, "
+                      << pipe.VertexCount() << " vertices, " << pipe.TriangleCount() << " triangles, generated in " << pipe.GenerateMilliseconds << " ms on " << hardwareThreads() << " threads" << std::endl;
+            pipePrimitivesQuery.Collect();
+            std::cout << "pipe buffers: " << (pipe.Vertices.size() + pipe.Indices.size()) * 4 << " bytes on the CPU path, "
+                      << gpuPipe.Bytes() << " bytes on the GPU path";
+            if (pipeOnGpu)
+                std::cout << ", " << (pipePrimitivesQuery.HasResult ? pipePrimitivesQuery.Result : 0) << " triangles tessellated";
+            std::cout << std::endl;
+            if (pipeEditing)
+                std::cout << "pipe edit: handle " << pipeEditHandle << ", last update " << pipe.UpdatedRings << " rings in "
+                          << pipe.UpdateMilliseconds << " ms" << std::endl;
+            std::cout << "terrain: " << (terrainAdaptive ? "adaptive" : "uniform") << " tessellation, "
+                      << terrainPixelsPerEdge << " px/edge, "
+                      << (terrainPrimitivesQuery.HasResult ? terrainPrimitivesQuery.Result : 0) << " primitives generated" << std::endl;
+            if (terrainStream.IsOpen()) {
+                TerrainStreamStats stats = terrainStream.Stats();
+                std::cout << "terrain stream: " << stats.ResidentTiles << "/" << stats.PoolSize << " tiles resident, "
+                          << stats.WantedTiles << " wanted, " << stats.PendingTiles << " pending, "
+                          << stats.Faults << " faults, " << stats.Loads << " loads, " << stats.Evictions << " evictions, "
+                          << stats.BytesRead / (1024 * 1024) << " MB read" << std::endl;
+            }
+            std::cout << "simulation: " << simulation.Ticks << " ticks of " << Simulation::TICK * 1000.0 << " ms, "
+                      << (simulation.IsThreaded() ? "on its own thread" : "stepped by the render loop") << std::endl;
+            std::cout << "vsync: " << (swapInterval ? "on" : "off") << ", frame cap: "
+                      << (frameRateCap > 0.0 ? std::to_string(static_cast<int>(frameRateCap)) + " fps" : "none") << std::endl;
+            framePacer.Print(std::cout);
+            profiler.Print(std::cout);
+        }
+
         // glfwѯ IO ¼/ͷżƶȣ
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        {
+            CpuScope swapScope("swap");
+            if (headless)
+                benchmark.EndFrame();
+            else
+                glfwSwapBuffers(window);
+        }
+        if (!headless)
+            glfwPollEvents();
+        profiler.EndFrame();
+        if (profileExportRequested) {
+            profileExportRequested = false;
+            profiler.ExportTrace("profile.json");
+        }
+
+        // ֡ʿƣ֡ʱȵһ֡ʼʱ̣Сʱ֡ʣ
+        // ׼ԺطŰ̶ʱ䲽Уȴ
+        if (!headless && !replayingInput) {
+            if (refreshRateStale) {
+                refreshRateStale = false;
+                const GLFWvidmode* videoMode = glfwGetVideoMode(windowMonitor(window));
+                refreshRate = videoMode ? videoMode->refreshRate : 0.0;
+            }
+            framePacer.TargetRate = frameRateCap;
+            framePacer.DisplayRate = swapInterval > 0 ? refreshRate / swapInterval : 0.0;
+            framePacer.Wait(glfwGetWindowAttrib(window, GLFW_ICONIFIED) || (idleWhenUnfocused && !glfwGetWindowAttrib(window, GLFW_FOCUSED)));
+        }
     }
 
+    if (headless)
+        benchmark.WriteReport(benchmarkReportPath, benchmarkScriptPath, SCR_WIDTH, SCR_HEIGHT, profiler);
+    else if (replayingInput)
+        profiler.Print(std::cout);
+    if (inputRecorder.IsOpen())
+        inputRecorder.Close(glfwGetTime());
+
     // ѡһԴ;ȡԴ
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &CeilingVAO);
@@ -1915,9 +2273,8 @@ int main()
     glDeleteBuffers(1, &VBO9);
 
 
-    // glfwֹǰ GLFW Դ
+    // glfwֹǰ GLFW Դ glfwSession ھֲ֮ɡ
     // ------------------------------------------------------------------
-    glfwTerminate();
     return 0;
 }
 
@@ -1925,28 +2282,45 @@ int main()
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow* window)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_ESCAPE) && window)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_W))
         camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_S))
         camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_A))
         camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_D))
         camera.ProcessKeyboard(RIGHT, deltaTime);
 
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_UP))
         windmillSpeed += 180.0f * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+    if (keyPressed(window, GLFW_KEY_DOWN))
         windmillSpeed -= 180.0f * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        windmillAngle += 2.0f * windmillSpeed * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        windmillAngle -= 2.0f * windmillSpeed * deltaTime;
+    if (keyPressed(window, GLFW_KEY_LEFT))
+        windmillNudge += 2.0f * windmillSpeed * deltaTime;
+    if (keyPressed(window, GLFW_KEY_RIGHT))
+        windmillNudge -= 2.0f * windmillSpeed * deltaTime;
+
+    // ƶѡеĹܵƱY/H  x ᣬU/J  y ᣬI/K  z 
+    if (pipeEditing) {
+        float step = 0.5f * deltaTime;
+        if (keyPressed(window, GLFW_KEY_Y))
+            pipeEditMove.x += step;
+        if (keyPressed(window, GLFW_KEY_H))
+            pipeEditMove.x -= step;
+        if (keyPressed(window, GLFW_KEY_U))
+            pipeEditMove.y += step;
+        if (keyPressed(window, GLFW_KEY_J))
+            pipeEditMove.y -= step;
+        if (keyPressed(window, GLFW_KEY_I))
+            pipeEditMove.z += step;
+        if (keyPressed(window, GLFW_KEY_K))
+            pipeEditMove.z -= step;
+    }
 
-    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET)) {
+    if (keyPressed(window, GLFW_KEY_LEFT_BRACKET)) {
         if (pipeMaterialSelect == 1) {
             pipeMetallic -= 0.2f * deltaTime;
             if (pipeMetallic < 0.0f)
@@ -1998,7 +2372,7 @@ void processInput(GLFWwindow* window)
                 areaLightColor.b = 0.0f;
         }
     }
-    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET)) {
+    if (keyPressed(window, GLFW_KEY_RIGHT_BRACKET)) {
         if (pipeMaterialSelect == 1) {
             pipeMetallic += 0.2f * deltaTime;
             if (pipeMetallic > 1)
@@ -2052,12 +2426,26 @@ void processInput(GLFWwindow* window)
     }
 }
 
+// طʱ״̬¼ļѯ
+bool keyPressed(GLFWwindow* window, int key)
+{
+    if (replayingInput)
+        return inputReplay.KeyDown(key);
+    return glfwGetKey(window, key) == GLFW_PRESS;
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    // طʱԴڵʵ룬ֻܻط¼¼ʱȼ¼
+    if (replayingInput && !inputReplay.Delivering)
+        return;
+    if (inputRecorder.IsOpen())
+        inputRecorder.Key(glfwGetTime(), key, scancode, action, mods);
+
     if (key == GLFW_KEY_F && action == GLFW_PRESS) {
         if (!windmillAppear) {
             windmillSpeed = 90.0f;
-            windmillAngle = 0.0f;
+            windmillNudge = -windmillAngle;
             windmillRotate = false;
             windmillColorful = false;
             windmillAppear = true;
@@ -2093,6 +2481,117 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (GLFW_KEY_0 <= key && key <= GLFW_KEY_9 && action == GLFW_PRESS) {
         pipeMaterialSelect = key - GLFW_KEY_0;
     }
+
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+        areaLightLTC = !areaLightLTC;
+    }
+
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        clusteredLighting = !clusteredLighting;
+    }
+
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS) {
+        deferredShading = !deferredShading;
+    }
+
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        shadowsEnabled = !shadowsEnabled;
+    }
+
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+        depthPrePass = !depthPrePass;
+    }
+
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS) {
+        transparentSorting = !transparentSorting;
+    }
+
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS) {
+        weightedBlendedOIT = !weightedBlendedOIT;
+    }
+
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        tableDisplay = !tableDisplay;
+    }
+
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        terrainAdaptive = !terrainAdaptive;
+    }
+
+    if (key == GLFW_KEY_MINUS && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        terrainPixelsPerEdge -= 1.0f;
+        if (terrainPixelsPerEdge < 1.0f)
+            terrainPixelsPerEdge = 1.0f;
+    }
+
+    if (key == GLFW_KEY_EQUAL && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        terrainPixelsPerEdge += 1.0f;
+        if (terrainPixelsPerEdge > 64.0f)
+            terrainPixelsPerEdge = 64.0f;
+    }
+
+    if (key == GLFW_KEY_R && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        terrainErosionRequested = true;
+    }
+
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        terrainStreamDisplay = !terrainStreamDisplay;
+    }
+
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        pipeEditing = !pipeEditing;
+    }
+
+    if (key == GLFW_KEY_TAB && action == GLFW_PRESS && pipeEditing) {
+        pipeEditHandle = (pipeEditHandle + 1) % 7;
+    }
+
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        pipeAdaptive = !pipeAdaptive;
+        pipeResampleRequested = true;
+    }
+
+    if (key == GLFW_KEY_COMMA && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        pipeTolerance /= 2.0f;
+        if (pipeTolerance < 0.0001f)
+            pipeTolerance = 0.0001f;
+        pipeResampleRequested = pipeAdaptive;
+    }
+
+    if (key == GLFW_KEY_PERIOD && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        pipeTolerance *= 2.0f;
+        if (pipeTolerance > 0.1f)
+            pipeTolerance = 0.1f;
+        pipeResampleRequested = pipeAdaptive;
+    }
+
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        profileExportRequested = true;
+    }
+
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+        pipeOnGpu = !pipeOnGpu;
+    }
+
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        pipeMorphing = !pipeMorphing;
+    }
+
+    // شֱͬ׼ûд
+    if (key == GLFW_KEY_F11 && action == GLFW_PRESS) {
+        swapInterval = swapInterval ? 0 : 1;
+        if (window)
+            glfwSwapInterval(swapInterval);
+    }
+
+    // л֡ޣơ3060120
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+        frameRateCap = frameRateCap == 0.0 ? 30.0 : frameRateCap < 120.0 ? frameRateCap * 2.0 : 0.0;
+    }
+
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        statsRequested = true;
+    }
 }
 
 // glfwÿڴС仯ͨϵͳûСʱ˻صִ
@@ -2109,6 +2608,11 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+    if (replayingInput && !inputReplay.Delivering)
+        return;
+    if (inputRecorder.IsOpen())
+        inputRecorder.Cursor(glfwGetTime(), xposIn, yposIn);
+
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
     if (firstMouse)
@@ -2131,43 +2635,46 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    if (replayingInput && !inputReplay.Delivering)
+        return;
+    if (inputRecorder.IsOpen())
+        inputRecorder.Scroll(glfwGetTime(), xoffset, yoffset);
+
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-// ʼѩ
-void initSnowParticle(SnowParticle& particle) {
-    float x_r = (rand() % 100) / 100.0f * 2 - 1.0f;
-    float z_r = (rand() % 100) / 100.0f * 2 - 1.0f;
-
-    float x_c = x_r * glm::sqrt(1 - z_r * z_r / 2.0f) * 0.5f;
-    float z_c = z_r * glm::sqrt(1 - x_r * x_r / 2.0f) * 0.5f;
-
-    particle.position = glm::vec3(x_c, (rand() % 100) / 100.0f * 1.5f, z_c);
-    particle.velocity = glm::vec3(0.0f, (rand() % 100) / 100.0f * 0.2f - 0.3f, 0.0f);
-    float colorTmp = (rand() % 100) / 100.0f * 0.4f;
-    particle.color = glm::vec3(1.0f - colorTmp, 1.0f - colorTmp, 1.0f);
+// glfwƶʱãڿƵһˢʲͬʾ
+// ----------------------------------------------------------------------
+void window_pos_callback(GLFWwindow*, int, int)
+{
+    refreshRateStale = true;
 }
 
-// ʼ
-void initLightParticle(LightParticle &particle) {
-    float x_r = (rand() % 100) / 100.0f * 2 - 1.0f;
-    float z_r = (rand() % 100) / 100.0f * 2 - 1.0f;
-
-    float x_c = x_r * glm::sqrt(1 - z_r * z_r / 2.0f) * 0.48f;
-    float z_c = z_r * glm::sqrt(1 - x_r * x_r / 2.0f) * 0.48f;
-
-    particle.position = glm::vec3(x_c, (rand() % 100) / 100.0f * 1.15f + 0.05f, z_c);
-    particle.velocity = glm::vec3((rand() % 100) / 100.0f * 0.06f - 0.03f, (rand() % 100) / 100.0f * 0.08f - 0.04f, (rand() % 100) / 100.0f * 0.06f - 0.03f);
-    float colorTmp = (rand() % 100) / 100.0f * 0.6f;
-    particle.color = glm::vec3(1.0f, 1.0f, 1.0f - colorTmp);
-
-    particle.flashDelTime = (rand() % 100) / 100.0f;
+// glfwϿʾʱ
+// ----------------------------------------------------------------------
+void monitor_callback(GLFWmonitor*, int)
+{
+    refreshRateStale = true;
 }
 
-glm::vec3 bezier2(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float t) {
-    return (1 - t) * (1 - t) * p0 + 2 * t * (1 - t) * p1 + t * t * p2;
+// ڵʾȫʱȫʾǰĵʾʱΪʾ
+// ----------------------------------------------------------------------
+GLFWmonitor* windowMonitor(GLFWwindow* window)
+{
+    if (GLFWmonitor* fullscreen = glfwGetWindowMonitor(window))
+        return fullscreen;
+    int x, y, width, height;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    int centerX = x + width / 2, centerY = y + height / 2;
+    int count = 0;
+    GLFWmonitor** monitors = glfwGetMonitors(&count);
+    for (int i = 0; i < count; i++) {
+        int monitorX, monitorY;
+        glfwGetMonitorPos(monitors[i], &monitorX, &monitorY);
+        const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+        if (mode && centerX >= monitorX && centerX < monitorX + mode->width && centerY >= monitorY && centerY < monitorY + mode->height)
+            return monitors[i];
+    }
+    return glfwGetPrimaryMonitor();
 }
-
-glm::vec3 bezier3(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
-    return (1 - t) * (1 - t) * (1 - t) * p0 + 3 * t * (1 - t) * (1 - t) * p1 + 3 * t * t * (1 - t) * p2 + t * t * t * p3;
-}
\ No newline at end of file
@@ -0,0 +1,320 @@
+// Fits linearly transformed cosines to the GGX specular lobe of shaders/arealighting.fs.glsl and writes
+// the lookup tables AreaLightLTC loads (layout in include/ltc.h). Follows the fitting procedure
+// of Heitz et al., "Real-Time Polygonal-Light Shading with Linearly Transformed Cosines" (2016):
+// for every roughness and view angle, a matrix M = [X Y Z] * [m11 0 m13; 0 m22 0; 0 0 1] is found with
+// Nelder-Mead so the transformed cosine distribution matches the BRDF times the cosine.
+//
+// usage: ltcfit [output] [table size]
+//        defaults to textures/ltc.bin, 64 x 64; takes a few minutes
+
+#include <glm/glm.hpp>
+
+#include "ltc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+const float PI = 3.14159265f;
+const int SAMPLES = 32;             // per dimension, for the error and the BRDF moments
+const float MIN_ALPHA = 0.0001f;
+
+// GGX with height-correlated Smith shadowing; eval returns BRDF * cos(theta_l)
+struct GgxBrdf
+{
+    static float lambda(float alpha, float cosTheta)
+    {
+        if (cosTheta >= 1.0f)
+            return 0.0f;
+        float a = 1.0f / alpha / std::tan(std::acos(cosTheta));
+        return 0.5f * (-1.0f + std::sqrt(1.0f + 1.0f / (a * a)));
+    }
+
+    static float eval(const glm::vec3& V, const glm::vec3& L, float alpha, float& pdf)
+    {
+        if (V.z <= 0.0f)
+        {
+            pdf = 0.0f;
+            return 0.0f;
+        }
+        float lambdaV = lambda(alpha, V.z);
+        float G2 = L.z > 0.0f ? 1.0f / (1.0f + lambdaV + lambda(alpha, L.z)) : 0.0f;
+
+        glm::vec3 H = glm::normalize(V + L);
+        float slopeX = H.x / H.z, slopeY = H.y / H.z;
+        float D = 1.0f / (1.0f + (slopeX * slopeX + slopeY * slopeY) / alpha / alpha);
+        D = D * D / (PI * alpha * alpha * H.z * H.z * H.z * H.z);
+
+        pdf = std::fabs(D * H.z / 4.0f / glm::dot(V, H));
+        return D * G2 / 4.0f / V.z;
+    }
+
+    // reflects V about a microfacet normal sampled from D
+    static glm::vec3 sample(const glm::vec3& V, float alpha, float u1, float u2)
+    {
+        float phi = 2.0f * PI * u1;
+        float r = alpha * std::sqrt(u2 / (1.0f - u2));
+        glm::vec3 N = glm::normalize(glm::vec3(r * std::cos(phi), r * std::sin(phi), 1.0f));
+        return -V + 2.0f * N * glm::dot(N, V);
+    }
+};
+
+struct Ltc
+{
+    float Magnitude = 1.0f, Fresnel = 1.0f;
+    float M11 = 1.0f, M22 = 1.0f, M13 = 0.0f;
+    glm::vec3 X = glm::vec3(1, 0, 0), Y = glm::vec3(0, 1, 0), Z = glm::vec3(0, 0, 1);
+
+    glm::mat3 M, InvM;
+    float DetM = 1.0f;
+
+    void update()
+    {
+        M = glm::mat3(X, Y, Z) * glm::mat3(M11, 0, 0, 0, M22, 0, M13, 0, 1);
+        InvM = glm::inverse(M);
+        DetM = std::fabs(glm::determinant(M));
+    }
+
+    float eval(const glm::vec3& L) const
+    {
+        glm::vec3 original = glm::normalize(InvM * L);
+        float l = glm::length(M * original);
+        float jacobian = DetM / (l * l * l);
+        float D = std::max(0.0f, original.z) / PI;
+        return Magnitude * D / jacobian;
+    }
+
+    glm::vec3 sample(float u1, float u2) const
+    {
+        float theta = std::acos(std::sqrt(u1));
+        float phi = 2.0f * PI * u2;
+        return glm::normalize(M * glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+    }
+};
+
+// norm of the BRDF, its Fresnel-weighted norm and its average direction
+void brdfMoments(const glm::vec3& V, float alpha, float& norm, float& fresnel, glm::vec3& direction)
+{
+    norm = fresnel = 0.0f;
+    direction = glm::vec3(0.0f);
+    for (int j = 0; j < SAMPLES; j++)
+    {
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            glm::vec3 L = GgxBrdf::sample(V, alpha, (i + 0.5f) / SAMPLES, (j + 0.5f) / SAMPLES);
+            float pdf;
+            float value = GgxBrdf::eval(V, L, alpha, pdf);
+            if (pdf > 0.0f)
+            {
+                float weight = value / pdf;
+                glm::vec3 H = glm::normalize(V + L);
+                norm += weight;
+                fresnel += weight * std::pow(1.0f - std::max(glm::dot(V, H), 0.0f), 5.0f);
+                direction += weight * L;
+            }
+        }
+    }
+    norm /= SAMPLES * SAMPLES;
+    fresnel /= SAMPLES * SAMPLES;
+    // the BRDF is isotropic, so the average direction lies in the plane of V and the normal
+    direction.y = 0.0f;
+    direction = glm::normalize(direction);
+}
+
+// multiple importance sampled L3 error between the LTC and the BRDF
+float fitError(const Ltc& ltc, const glm::vec3& V, float alpha)
+{
+    double error = 0.0;
+    for (int j = 0; j < SAMPLES; j++)
+    {
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            float u1 = (i + 0.5f) / SAMPLES, u2 = (j + 0.5f) / SAMPLES;
+            for (const glm::vec3& L : { ltc.sample(u1, u2), GgxBrdf::sample(V, alpha, u1, u2) })
+            {
+                float pdfBrdf;
+                float brdf = GgxBrdf::eval(V, L, alpha, pdfBrdf);
+                float value = ltc.eval(L);
+                float pdfLtc = value / ltc.Magnitude;
+                double difference = std::fabs(brdf - value);
+                error += difference * difference * difference / (pdfLtc + pdfBrdf);
+            }
+        }
+    }
+    return float(error / (SAMPLES * SAMPLES));
+}
+
+// downhill simplex minimisation of f over 3 parameters
+template <typename Function>
+void nelderMead(float result[3], const float start[3], float delta, float tolerance, int maxIterations, Function f)
+{
+    const int DIM = 3;
+    float s[DIM + 1][DIM], value[DIM + 1];
+    for (int i = 0; i <= DIM; i++)
+    {
+        for (int k = 0; k < DIM; k++)
+            s[i][k] = start[k] + (i == k + 1 ? delta : 0.0f);
+        value[i] = f(s[i]);
+    }
+
+    int lo = 0;
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        int hi = 0, nh = 0;
+        lo = 0;
+        for (int i = 1; i <= DIM; i++)
+        {
+            if (value[i] < value[lo])
+                lo = i;
+            if (value[i] > value[hi])
+            {
+                nh = hi;
+                hi = i;
+            }
+            else if (value[i] > value[nh])
+                nh = i;
+        }
+        float a = std::fabs(value[lo]), b = std::fabs(value[hi]);
+        if (2.0f * std::fabs(a - b) < (a + b) * tolerance)
+            break;
+
+        float centroid[DIM] = {};
+        for (int i = 0; i <= DIM; i++)
+            if (i != hi)
+                for (int k = 0; k < DIM; k++)
+                    centroid[k] += s[i][k] / DIM;
+
+        float reflected[DIM];
+        for (int k = 0; k < DIM; k++)
+            reflected[k] = 2.0f * centroid[k] - s[hi][k];
+        float valueReflected = f(reflected);
+        if (valueReflected < value[nh])
+        {
+            if (valueReflected < value[lo])
+            {
+                float expanded[DIM];
+                for (int k = 0; k < DIM; k++)
+                    expanded[k] = 3.0f * centroid[k] - 2.0f * s[hi][k];
+                float valueExpanded = f(expanded);
+                if (valueExpanded < valueReflected)
+                {
+                    std::copy(expanded, expanded + DIM, s[hi]);
+                    value[hi] = valueExpanded;
+                    continue;
+                }
+            }
+            std::copy(reflected, reflected + DIM, s[hi]);
+            value[hi] = valueReflected;
+            continue;
+        }
+
+        float contracted[DIM];
+        for (int k = 0; k < DIM; k++)
+            contracted[k] = 0.5f * centroid[k] + 0.5f * s[hi][k];
+        float valueContracted = f(contracted);
+        if (valueContracted < value[hi])
+        {
+            std::copy(contracted, contracted + DIM, s[hi]);
+            value[hi] = valueContracted;
+            continue;
+        }
+
+        // shrink towards the best point
+        for (int i = 0; i <= DIM; i++)
+        {
+            if (i == lo)
+                continue;
+            for (int k = 0; k < DIM; k++)
+                s[i][k] = 0.5f * (s[lo][k] + s[i][k]);
+            value[i] = f(s[i]);
+        }
+    }
+    std::copy(s[lo], s[lo] + DIM, result);
+}
+
+void fit(Ltc& ltc, const glm::vec3& V, float alpha, bool isotropic)
+{
+    auto apply = [&](const float* p)
+    {
+        ltc.M11 = std::max(p[0], 1e-7f);
+        ltc.M22 = isotropic ? ltc.M11 : std::max(p[1], 1e-7f);
+        ltc.M13 = isotropic ? 0.0f : p[2];
+        ltc.update();
+    };
+    float start[3] = { ltc.M11, ltc.M22, ltc.M13 }, result[3];
+    nelderMead(result, start, 0.05f, 1e-5f, 100, [&](const float* p) { apply(p); return fitError(ltc, V, alpha); });
+    apply(result);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = argc > 1 ? argv[1] : "textures/ltc.bin";
+    int size = argc > 2 ? std::atoi(argv[2]) : 64;
+    if (size < 2 || size > 1024)
+    {
+        std::cout << "usage: ltcfit [output] [table size]" << std::endl;
+        return 1;
+    }
+
+    std::vector<glm::vec4> inverseMatrices(size * size), norms(size * size);
+    std::vector<Ltc> fits(size * size);
+
+    // smoothest first, each fit starts from its neighbour's result
+    for (int a = size - 1; a >= 0; a--)
+    {
+        for (int t = 0; t < size; t++)
+        {
+            float x = t / float(size - 1);
+            float theta = std::min(1.57f, std::acos(1.0f - x * x));
+            glm::vec3 V(std::sin(theta), 0.0f, std::cos(theta));
+            float roughness = a / float(size - 1);
+            float alpha = std::max(roughness * roughness, MIN_ALPHA);
+
+            Ltc ltc = t > 0 ? fits[a + (t - 1) * size] : a < size - 1 ? fits[a + 1] : Ltc();
+            glm::vec3 direction;
+            brdfMoments(V, alpha, ltc.Magnitude, ltc.Fresnel, direction);
+
+            bool isotropic = t == 0;
+            if (isotropic)
+            {
+                // at normal incidence the lobe is round and centred on the normal
+                ltc.X = glm::vec3(1, 0, 0);
+                ltc.Y = glm::vec3(0, 1, 0);
+                ltc.Z = glm::vec3(0, 0, 1);
+            }
+            else
+            {
+                ltc.X = glm::vec3(direction.z, 0, -direction.x);
+                ltc.Y = glm::vec3(0, 1, 0);
+                ltc.Z = direction;
+            }
+            ltc.update();
+            fit(ltc, V, alpha, isotropic);
+            fits[a + t * size] = ltc;
+
+            glm::mat3 inverse = ltc.InvM / ltc.InvM[1][1];
+            inverseMatrices[a + t * size] = glm::vec4(inverse[0][0], inverse[0][2], inverse[2][0], inverse[2][2]);
+            norms[a + t * size] = glm::vec4(ltc.Magnitude, ltc.Fresnel, 0.0f, 0.0f);
+        }
+        std::cout << "\r" << size - a << " / " << size << " roughness rows" << std::flush;
+    }
+    std::cout << std::endl;
+
+    LtcTableHeader header = {};
+    std::memcpy(header.Magic, "LTC1", 4);
+    header.Size = size;
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)inverseMatrices.data(), header.TableBytes());
+    file.write((const char*)norms.data(), header.TableBytes());
+    if (!file)
+    {
+        std::cout << "ERROR::LTCFIT::WRITE_FAILED: " << path << std::endl;
+        return 1;
+    }
+    std::cout << "wrote " << path << ": " << size << " x " << size << " LTC tables" << std::endl;
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Times the CPU-side generation and simulation kernels of the scene one at a time, outside the
+// render loop and without an OpenGL context: heightfield generation and smoothing, the pipe sweep,
+// the snow and light particle updates, model import and texture decoding.
+//
+// Every kernel runs over a few problem sizes. A run is warmed up first, then repeated until enough
+// samples are in; calls too short for the clock are batched so one sample takes at least 100 us.
+// The table gives the median and 99th percentile time of one call and the throughput at the median.
+//
+// usage: microbench [filter] [model]...
+//        runs the kernels whose name contains filter (all by default); the model import and the
+//        texture decoding use the scene's models unless other model files are given
+
+#include "terrain.h"
+#include "pipe.h"
+#include "particles.h"
+#include "model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+using clock_type = std::chrono::steady_clock;
+
+const double WARMUP_SECONDS = 0.2;
+const double MEASURE_SECONDS = 1.0;
+const int MIN_SAMPLES = 10;
+const int MAX_SAMPLES = 1000;
+const double MIN_SAMPLE_SECONDS = 100e-6;
+
+std::string filter;
+
+double secondsSince(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// Times fn(), which does `work` units of work per call (samples, vertices, particles, pixels), and
+// prints one row of the table.
+template <typename Function>
+void measure(const std::string& kernel, const std::string& size, double work, const char* unit, Function fn)
+{
+    if (kernel.find(filter) == std::string::npos)
+        return;
+
+    // warm up the caches and the allocator, and find how many calls make one sample
+    int batch = 1;
+    auto warmupStart = clock_type::now();
+    do
+    {
+        auto start = clock_type::now();
+        for (int i = 0; i < batch; i++)
+            fn();
+        double seconds = secondsSince(start);
+        if (seconds < MIN_SAMPLE_SECONDS)
+            batch = std::min(batch * 2, 1 << 20);
+    } while (secondsSince(warmupStart) < WARMUP_SECONDS);
+
+    std::vector<double> samples;
+    auto measureStart = clock_type::now();
+    while ((int)samples.size() < MIN_SAMPLES || (secondsSince(measureStart) < MEASURE_SECONDS && (int)samples.size() < MAX_SAMPLES))
+    {
+        auto start = clock_type::now();
+        for (int i = 0; i < batch; i++)
+            fn();
+        samples.push_back(secondsSince(start) / batch);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double median = samples[samples.size() / 2];
+    double p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    std::cout << std::left << std::setw(28) << kernel << std::setw(24) << size << std::right << std::fixed
+              << std::setprecision(4) << std::setw(12) << median * 1e3 << std::setw(12) << p99 * 1e3
+              << std::setprecision(2) << std::setw(12) << work / median / 1e6 << " M" << unit << "/s"
+              << "  (" << samples.size() << " x " << batch << ")" << std::endl;
+}
+
+void benchmarkTerrain()
+{
+    for (unsigned int size : { 128u, 256u, 512u, 1024u })
+    {
+        Heightmap heightmap(size);
+        std::string label = std::to_string(size) + "^2";
+        measure("terrain perlin (3 octaves)", label, double(size) * size, "samples", [&] { heightmap.GeneratePerlin(size / 40.0f, 3); });
+        measure("terrain smooth (radius 1)", label, double(size) * size, "samples", [&] { heightmap.Smooth(1); });
+    }
+}
+
+// the scene's pipe: square, ellipse and circle key sections along the same Bézier path
+void setupPipe(PipeSweep& pipe, int sampleCount)
+{
+    const glm::vec3 controlPoints[] = { { -0.5f, 0.0f, 0.0f }, { -0.2f, -1.0f, -1.0f }, { 0.2f, 1.0f, 1.0f }, { 0.5f, 0.0f, 0.0f } };
+    for (int i = 0; i < 4; i++)
+        pipe.ControlPoints[i] = controlPoints[i];
+    for (int i = 0; i < sampleCount; i++)
+    {
+        float side = glm::floor(i * 4.0f / sampleCount), along = i * 4.0f / sampleCount - side - 0.5f;
+        glm::vec2 square = side == 0 ? glm::vec2(0.5f, along) : side == 1 ? glm::vec2(-along, 0.5f) : side == 2 ? glm::vec2(-0.5f, -along) : glm::vec2(along, -0.5f);
+        float angle = glm::radians(360.0f / sampleCount * i);
+        pipe.KeySections[0].push_back(glm::vec3(-0.5f, square.y, square.x));
+        pipe.KeySections[1].push_back(glm::vec3(0.0f, glm::sin(angle) * 0.4f, glm::cos(angle) * 0.7f));
+        pipe.KeySections[2].push_back(glm::vec3(0.5f, glm::sin(angle) * 0.6f, glm::cos(angle) * 0.6f));
+    }
+}
+
+void benchmarkPipe()
+{
+    for (int rings : { 64, 256, 1024 })
+    {
+        PipeSweep pipe;
+        setupPipe(pipe, 256);
+        pipe.SetUniformSampling(rings);
+        std::string label = std::to_string(rings) + " rings x 256";
+        double vertices = double(pipe.VertexCount());
+        measure("pipe sweep (1 thread)", label, vertices, "vertices", [&] { pipe.Generate(1); });
+        measure("pipe sweep (parallel)", label, vertices, "vertices", [&] { pipe.Generate(); });
+        measure("pipe adaptive sampling", label, vertices, "vertices", [&] { pipe.SetAdaptiveSampling(rings, 0.001f, glm::vec3(0.25f, 0.12f, 0.12f)); });
+    }
+}
+
+void benchmarkParticles()
+{
+    const SnowCollider tree = { 1.18f, 0.12f, 0.40f };
+    const float deltaTime = 1.0f / 60.0f;
+    for (int count : { 400, 4000, 40000, 400000 })
+    {
+        std::vector<SnowParticle> snow(count);
+        for (auto& particle : snow)
+            initSnowParticle(particle);
+        measure("snow update", std::to_string(count) + " particles", count, "particles", [&] { updateSnowParticles(snow, deltaTime, tree); });
+    }
+    for (int count : { 100, 1000, 10000, 100000 })
+    {
+        std::vector<LightParticle> lights(count);
+        for (auto& particle : lights)
+            initLightParticle(particle);
+        measure("light update", std::to_string(count) + " particles", count, "particles", [&] { updateLightParticles(lights, deltaTime); });
+    }
+}
+
+std::string fileName(const std::string& path)
+{
+    return path.substr(path.find_last_of("/\\") + 1);
+}
+
+void benchmarkAssets(const std::vector<std::string>& models)
+{
+    // every texture the models refer to, plus the particle sprite
+    std::set<std::pair<std::string, std::string>> textures = { { "textures", "glow.png" } };
+    for (const std::string& path : models)
+    {
+        std::vector<ImportedMesh> meshes;
+        if (!ImportModel(path, meshes))
+            continue;
+        double vertices = 0.0;
+        for (const ImportedMesh& mesh : meshes)
+        {
+            vertices += mesh.vertices.size();
+            for (const auto& texture : mesh.textures)
+                textures.insert({ path.substr(0, path.find_last_of('/')), texture.second });
+        }
+        measure("model import", fileName(path), vertices, "vertices", [&] { meshes.clear(); ImportModel(path, meshes); });
+    }
+
+    for (const auto& texture : textures)
+    {
+        TextureImage image = DecodeTextureFile(texture.second.c_str(), texture.first);
+        if (!image.data)
+        {
+            std::cout << "Texture failed to load at path: " << texture.first << '/' << texture.second << std::endl;
+            continue;
+        }
+        std::string label = fileName(texture.second) + " " + std::to_string(image.width) + "x" + std::to_string(image.height);
+        measure("texture decode", label, double(image.width) * image.height, "pixels", [&] { image = DecodeTextureFile(texture.second.c_str(), texture.first); });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    filter = argc > 1 ? argv[1] : "";
+    std::vector<std::string> models(argv + std::min(argc, 2), argv + argc);
+    if (models.empty())
+        models = { "models/obj/christmas_tree/christmas_tree.obj", "models/obj/table/table.obj" };
+    srand(1);
+
+    std::cout << std::left << std::setw(28) << "kernel" << std::setw(24) << "size" << std::right << std::setw(12) << "median ms"
+              << std::setw(12) << "p99 ms" << std::setw(12) << "throughput" << std::endl;
+    benchmarkTerrain();
+    benchmarkPipe();
+    benchmarkParticles();
+    benchmarkAssets(models);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Writes a tiled 16-bit heightfield dataset for TerrainStream (layout in include/tiles.h),
+// so the streaming terrain can be tried without any real elevation data.
+//
+// usage: terraingen [output] [tiles per side] [samples per tile side]
+//        defaults to terrain.tiles, 16 x 16 tiles of 257 x 257 samples (about 34 MB)
+
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+
+#include "tiles.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// fractal Perlin noise at a global sample position, in [0, 1]
+float heightAt(float x, float z)
+{
+    glm::vec2 p = glm::vec2(x, z) / 512.0f;
+    float noise = 0.0f, amplitude = 1.0f, total = 0.0f;
+    for (int i = 0; i < 6; i++)
+    {
+        noise += glm::perlin(p) * amplitude;
+        total += amplitude;
+        p *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return glm::clamp(noise / total / 2 + 0.5f, 0.0f, 1.0f);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = argc > 1 ? argv[1] : "terrain.tiles";
+    int tiles = argc > 2 ? std::atoi(argv[2]) : 16;
+    int tileSize = argc > 3 ? std::atoi(argv[3]) : 257;
+    if (tiles < 1 || tileSize < 2 || tileSize > 4097)
+    {
+        std::cout << "usage: terraingen [output] [tiles per side] [samples per tile side]" << std::endl;
+        return 1;
+    }
+
+    TileDatasetHeader header = {};
+    std::memcpy(header.Magic, "TILE", 4);
+    header.TileSize = tileSize;
+    header.TilesX = tiles;
+    header.TilesZ = tiles;
+    header.TileExtent = 8.0f;
+    header.HeightScale = 6.0f;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::TERRAINGEN::FILE_NOT_WRITABLE: " << path << std::endl;
+        return 1;
+    }
+    file.write((const char*)&header, sizeof(header));
+
+    std::vector<uint16_t> heights(size_t(tileSize) * tileSize);
+    for (int tz = 0; tz < tiles; tz++)
+    {
+        for (int tx = 0; tx < tiles; tx++)
+        {
+            // neighbouring tiles share their border row and column of samples
+            for (int z = 0; z < tileSize; z++)
+                for (int x = 0; x < tileSize; x++)
+                    heights[z * tileSize + x] = uint16_t(heightAt(float(tx * (tileSize - 1) + x), float(tz * (tileSize - 1) + z)) * 65535.0f + 0.5f);
+            file.write((const char*)heights.data(), heights.size() * sizeof(uint16_t));
+        }
+        std::cout << "\r" << (tz + 1) * tiles << " / " << tiles * tiles << " tiles" << std::flush;
+    }
+    std::cout << std::endl;
+
+    if (!file)
+    {
+        std::cout << "ERROR::TERRAINGEN::WRITE_FAILED: " << path << std::endl;
+        return 1;
+    }
+    std::cout << "wrote " << path << ": " << tiles << " x " << tiles << " tiles of " << tileSize << " x " << tileSize << " samples" << std::endl;
+    return 0;
+}